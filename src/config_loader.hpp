@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <string>
@@ -30,10 +31,41 @@ struct AppConfig {
     std::string logFilePath = "logs/run_latest.txt";
     bool pauseOnExit = false;
     int maxOptimizationIterations = 20000;
+    bool useDontLookBits = true;
+    bool useSymmetryReduction = true;     // skip swaps/rotations inside runs of same-instant purchases
+    bool useScoreBound = true;            // drop candidates whose optimistic score can't beat the best
+    double screeningTolerance = 0.0;      // 0 = off; else drop candidates trailing the best by this share early
+    std::string resultFilePath;           // empty = don't write a result file
+    std::string replanFromResult;         // previous result file to warm-start from
+    double replanElapsedHours = 0.0;      // hours since the original launch
+    int replanMaxIterations = 2000;
+    std::string resultCacheDir;           // empty = no result cache
+    std::string traceFilePath;            // empty = no Chrome trace of the run
+    int resultCacheMaxEntries = 200;
+    double resultCacheMaxDistance = 6.0;  // nearest cached config to warm-start from
+    int selfCheckInterval = 0;            // 0 = off; else re-simulate every Nth evaluation with the reference simulator
+    int robustSamples = 0;                // 0 = score against the busy windows exactly as given
+    double robustJitterHours = 1.0;       // standard deviation of each sampled window edge
+    std::string robustObjective = "mean"; // "mean" or "quantile"
+    double robustQuantile = 0.1;          // used when robustObjective is "quantile"
+    int robustSeed = 1;
+    long long seed = 0;                   // search seed; 0 = pick one at random (it is logged)
+    std::string objective = "score";      // "score" (weighted end-of-event resources) or "timeToTarget"
+    int memeticPopulation = 0;            // 0 = plain local search
+    int memeticGenerations = 20;
+    int memeticPolishIterations = 300;    // local-search iteration cap for each child
+    int lnsWindow = 0;                    // 0 = off; else upgrades per exactly re-solved window
+    int lnsRounds = 5;
+    int tabuIterations = 0;               // 0 = off; else tabu-search iterations after the local search
+    int tabuTenure = 12;                  // iterations a reversed move stays forbidden
+    int tabuCandidates = 128;             // sampled moves evaluated per iteration
+    bool upgradeReport = false;           // per-upgrade removal value and timing slack after the run
+    double upgradeReportTolerance = 0.001; // score share a late purchase may cost before it counts
 
     // Vectors
     std::vector<int> currentLevels = std::vector<int>(21, 0);
     std::vector<double> resourceCounts = {0,500000,0,0,0,0,0,1,1,0};
+    std::vector<double> targetResources = std::vector<double>(10, 0.0);  // timeToTarget goals; 0 = none
     std::vector<int> upgradePath;
     std::vector<double> busyTimesStart;
     std::vector<double> busyTimesEnd;
@@ -85,21 +117,8 @@ inline bool parseClockHours(const std::string& text, double& out){
     }
 }
 
-inline AppConfig loadConfig(const std::string& path){
+inline AppConfig configFromJson(const nlohmann::json& j){
     AppConfig cfg;
-    std::ifstream f(path);
-    if(!f.good()){
-        std::cerr << "config.json not found; using defaults.\n";
-        return cfg;
-    }
-    nlohmann::json j;
-    try {
-        j = nlohmann::json::parse(f);
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to parse config.json: " << e.what() << "\n";
-        return cfg;
-    }
-
     auto safeAssign = [&](const char* key, auto& out) {
         const nlohmann::json* it = j.find(key);
         if (!it || it->is_null()) {
@@ -136,6 +155,36 @@ inline AppConfig loadConfig(const std::string& path){
     safeAssign("appendLogFile", cfg.appendLogFile);
     safeAssign("pauseOnExit", cfg.pauseOnExit);
     safeAssign("maxOptimizationIterations", cfg.maxOptimizationIterations);
+    safeAssign("useDontLookBits", cfg.useDontLookBits);
+    safeAssign("useSymmetryReduction", cfg.useSymmetryReduction);
+    safeAssign("useScoreBound", cfg.useScoreBound);
+    safeAssign("screeningTolerance", cfg.screeningTolerance);
+    safeAssign("resultFilePath", cfg.resultFilePath);
+    safeAssign("replanFromResult", cfg.replanFromResult);
+    safeAssign("replanElapsedHours", cfg.replanElapsedHours);
+    safeAssign("replanMaxIterations", cfg.replanMaxIterations);
+    safeAssign("resultCacheDir", cfg.resultCacheDir);
+    safeAssign("traceFilePath", cfg.traceFilePath);
+    safeAssign("resultCacheMaxEntries", cfg.resultCacheMaxEntries);
+    safeAssign("resultCacheMaxDistance", cfg.resultCacheMaxDistance);
+    safeAssign("selfCheckInterval", cfg.selfCheckInterval);
+    safeAssign("robustSamples", cfg.robustSamples);
+    safeAssign("robustJitterHours", cfg.robustJitterHours);
+    safeAssign("robustObjective", cfg.robustObjective);
+    safeAssign("robustQuantile", cfg.robustQuantile);
+    safeAssign("robustSeed", cfg.robustSeed);
+    safeAssign("seed", cfg.seed);
+    safeAssign("objective", cfg.objective);
+    safeAssign("memeticPopulation", cfg.memeticPopulation);
+    safeAssign("memeticGenerations", cfg.memeticGenerations);
+    safeAssign("memeticPolishIterations", cfg.memeticPolishIterations);
+    safeAssign("lnsWindow", cfg.lnsWindow);
+    safeAssign("lnsRounds", cfg.lnsRounds);
+    safeAssign("tabuIterations", cfg.tabuIterations);
+    safeAssign("tabuTenure", cfg.tabuTenure);
+    safeAssign("tabuCandidates", cfg.tabuCandidates);
+    safeAssign("upgradeReport", cfg.upgradeReport);
+    safeAssign("upgradeReportTolerance", cfg.upgradeReportTolerance);
 
     if (const nlohmann::json* logPathIt = j.find("logFilePath")) {
         if (!logPathIt->is_null()) {
@@ -207,6 +256,7 @@ inline AppConfig loadConfig(const std::string& path){
 
     loadIntArray("currentLevels", cfg.currentLevels, 21);
     loadDoubleArray("resourceCounts", cfg.resourceCounts, 10, 0.0);
+    loadDoubleArray("targetResources", cfg.targetResources, 10, 0.0);
     loadIntArray("upgradePath", cfg.upgradePath, 0);
     loadDoubleArray("busyTimesStart", cfg.busyTimesStart, 0);
     loadDoubleArray("busyTimesEnd", cfg.busyTimesEnd, 0);
@@ -249,5 +299,121 @@ inline AppConfig loadConfig(const std::string& path){
         cfg.maxOptimizationIterations = 0;
     }
 
+    if (cfg.replanElapsedHours < 0) {
+        std::cerr << "Invalid value for 'replanElapsedHours': expected non-negative number. Clamping to 0.\n";
+        cfg.replanElapsedHours = 0.0;
+    }
+    if (cfg.replanMaxIterations < 0) {
+        std::cerr << "Invalid value for 'replanMaxIterations': expected non-negative integer. Clamping to 0.\n";
+        cfg.replanMaxIterations = 0;
+    }
+    if (cfg.resultCacheMaxEntries < 1) {
+        std::cerr << "Invalid value for 'resultCacheMaxEntries': expected positive integer. Clamping to 1.\n";
+        cfg.resultCacheMaxEntries = 1;
+    }
+    if (cfg.resultCacheMaxDistance < 0) {
+        std::cerr << "Invalid value for 'resultCacheMaxDistance': expected non-negative number. Clamping to 0.\n";
+        cfg.resultCacheMaxDistance = 0.0;
+    }
+    if (cfg.selfCheckInterval < 0) {
+        std::cerr << "Invalid value for 'selfCheckInterval': expected non-negative integer. Clamping to 0.\n";
+        cfg.selfCheckInterval = 0;
+    }
+    if (cfg.robustSamples < 0 || cfg.robustSamples > 256) {
+        std::cerr << "Invalid value for 'robustSamples': expected integer in [0, 256]. Clamping.\n";
+        cfg.robustSamples = std::clamp(cfg.robustSamples, 0, 256);
+    }
+    if (cfg.screeningTolerance < 0) {
+        std::cerr << "Invalid value for 'screeningTolerance': expected non-negative number. Clamping to 0.\n";
+        cfg.screeningTolerance = 0.0;
+    }
+    if (cfg.robustJitterHours < 0) {
+        std::cerr << "Invalid value for 'robustJitterHours': expected non-negative number. Clamping to 0.\n";
+        cfg.robustJitterHours = 0.0;
+    }
+    if (cfg.robustObjective != "mean" && cfg.robustObjective != "quantile") {
+        std::cerr << "Invalid value for 'robustObjective': expected \"mean\" or \"quantile\". Using \"mean\".\n";
+        cfg.robustObjective = "mean";
+    }
+    if (cfg.memeticPopulation < 0 || cfg.memeticPopulation > 256) {
+        std::cerr << "Invalid value for 'memeticPopulation': expected integer in [0, 256]. Clamping.\n";
+        cfg.memeticPopulation = std::clamp(cfg.memeticPopulation, 0, 256);
+    }
+    if (cfg.memeticPopulation == 1) {
+        std::cerr << "Invalid value for 'memeticPopulation': a population needs at least 2 members. Using 2.\n";
+        cfg.memeticPopulation = 2;
+    }
+    if (cfg.memeticGenerations < 0) {
+        std::cerr << "Invalid value for 'memeticGenerations': expected non-negative integer. Clamping to 0.\n";
+        cfg.memeticGenerations = 0;
+    }
+    if (cfg.memeticPolishIterations < 0) {
+        std::cerr << "Invalid value for 'memeticPolishIterations': expected non-negative integer. Clamping to 0.\n";
+        cfg.memeticPolishIterations = 0;
+    }
+    if (cfg.lnsWindow != 0 && (cfg.lnsWindow < 2 || cfg.lnsWindow > 10)) {
+        std::cerr << "Invalid value for 'lnsWindow': expected 0 or an integer in [2, 10]. Clamping.\n";
+        cfg.lnsWindow = std::clamp(cfg.lnsWindow, 2, 10);
+    }
+    if (cfg.lnsRounds < 0) {
+        std::cerr << "Invalid value for 'lnsRounds': expected non-negative integer. Clamping to 0.\n";
+        cfg.lnsRounds = 0;
+    }
+    if (cfg.tabuIterations < 0) {
+        std::cerr << "Invalid value for 'tabuIterations': expected non-negative integer. Clamping to 0.\n";
+        cfg.tabuIterations = 0;
+    }
+    if (cfg.tabuTenure < 0) {
+        std::cerr << "Invalid value for 'tabuTenure': expected non-negative integer. Clamping to 0.\n";
+        cfg.tabuTenure = 0;
+    }
+    if (cfg.upgradeReportTolerance < 0) {
+        std::cerr << "Invalid value for 'upgradeReportTolerance': expected non-negative number. Clamping to 0.\n";
+        cfg.upgradeReportTolerance = 0.0;
+    }
+    if (cfg.tabuCandidates < 1) {
+        std::cerr << "Invalid value for 'tabuCandidates': expected positive integer. Clamping to 1.\n";
+        cfg.tabuCandidates = 1;
+    }
+    for (double& target : cfg.targetResources) {
+        if (target < 0) {
+            std::cerr << "Invalid value in 'targetResources': expected non-negative numbers. Clamping to 0.\n";
+            target = 0.0;
+        }
+    }
+    if (cfg.targetResources[9] > EVENT_CURRENCY_CAP) {
+        std::cerr << "Event currency target exceeds cap of " << EVENT_CURRENCY_CAP << ". Clamping.\n";
+        cfg.targetResources[9] = EVENT_CURRENCY_CAP;
+    }
+    if (cfg.objective != "score" && cfg.objective != "timeToTarget") {
+        std::cerr << "Invalid value for 'objective': expected \"score\" or \"timeToTarget\". Using \"score\".\n";
+        cfg.objective = "score";
+    }
+    if (cfg.objective == "timeToTarget"
+        && std::none_of(cfg.targetResources.begin(), cfg.targetResources.end(), [](double t) { return t > 0; })) {
+        std::cerr << "'timeToTarget' needs at least one positive entry in 'targetResources'. Using \"score\".\n";
+        cfg.objective = "score";
+    }
+    if (cfg.robustQuantile < 0 || cfg.robustQuantile > 1) {
+        std::cerr << "Invalid value for 'robustQuantile': expected number in [0, 1]. Clamping.\n";
+        cfg.robustQuantile = std::clamp(cfg.robustQuantile, 0.0, 1.0);
+    }
+
     return cfg;
 }
+
+inline AppConfig loadConfig(const std::string& path){
+    std::ifstream f(path);
+    if(!f.good()){
+        std::cerr << "config.json not found; using defaults.\n";
+        return AppConfig{};
+    }
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(f);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to parse config.json: " << e.what() << "\n";
+        return AppConfig{};
+    }
+    return configFromJson(j);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Counter-based random stream: draw n of stream (seed, id) is a pure function of
+// those three numbers, so a task's randomness does not depend on which thread
+// runs it or on what other tasks drew before. The search draws through the
+// fixed reductions below rather than <random> distributions, whose algorithms
+// differ between standard libraries: a seed gives the same path on every build.
+class CounterRng {
+public:
+    using result_type = std::uint64_t;
+
+    CounterRng() = default;
+    explicit CounterRng(std::uint64_t seed, std::uint64_t stream = 0)
+        : key(mix(seed + GOLDEN_GAMMA * mix(stream + 1))) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+    result_type operator()() { return mix(key + GOLDEN_GAMMA * ++counter); }
+
+    // Uniform in [0, bound) for bound > 0, by multiply-shift on the high 32 bits.
+    int below(int bound) {
+        return static_cast<int>((((*this)() >> 32) * static_cast<std::uint64_t>(bound)) >> 32);
+    }
+    // Uniform in [lo, hi].
+    int uniformInt(int lo, int hi) {
+        return lo + below(hi - lo + 1);
+    }
+    // Uniform in [0, 1) with 53 random bits.
+    double unit() {
+        return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+    // Standard normal by Box-Muller (one value per two draws).
+    double normal() {
+        const double radius = std::sqrt(-2.0 * std::log(1.0 - unit()));
+        return radius * std::cos(6.283185307179586 * unit());
+    }
+
+    // Independent child stream, e.g. one per parallel task index.
+    CounterRng stream(std::uint64_t id) const { return CounterRng(key, id); }
+
+private:
+    static constexpr std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+    static std::uint64_t mix(std::uint64_t z) {   // SplitMix64 finaliser
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t key = 0;
+    std::uint64_t counter = 0;
+};
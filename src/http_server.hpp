@@ -0,0 +1,363 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socket_handle = SOCKET;
+inline constexpr socket_handle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+inline void closeSocketHandle(socket_handle s) { closesocket(s); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using socket_handle = int;
+inline constexpr socket_handle INVALID_SOCKET_HANDLE = -1;
+inline void closeSocketHandle(socket_handle s) { close(s); }
+#endif
+
+// Minimal HTTP/1.1 server bound to 127.0.0.1 for the GUI. One thread per
+// connection; responses are either a single body or a Server-Sent Events stream.
+
+inline constexpr size_t HTTP_MAX_HEADER_BYTES = 64 * 1024;
+inline constexpr size_t HTTP_MAX_BODY_BYTES = 4 * 1024 * 1024;
+inline constexpr int HTTP_MAX_CONNECTIONS = 32;         // open connections, event streams included
+inline constexpr int HTTP_READ_TIMEOUT_SECONDS = 10;    // per recv while reading a request
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::map<std::string, std::string> headers;   // keys lower-cased
+    std::string body;
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+    std::string queryParam(const std::string& name) const {
+        std::istringstream in(query);
+        std::string pair;
+        while (std::getline(in, pair, '&')) {
+            const auto eq = pair.find('=');
+            if (pair.substr(0, eq) == name) {
+                return eq == std::string::npos ? std::string() : pair.substr(eq + 1);
+            }
+        }
+        return std::string();
+    }
+};
+
+class HttpConnection {
+public:
+    explicit HttpConnection(socket_handle socket) : socket(socket) {}
+
+    // Origin echoed back in the CORS headers; empty for requests without one.
+    void setAllowedOrigin(const std::string& origin) { allowedOrigin = origin; }
+
+    bool sendRaw(const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL;
+#else
+            const int flags = 0;
+#endif
+            const auto n = ::send(socket, data.data() + sent, static_cast<int>(data.size() - sent), flags);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    bool sendResponse(int status, const std::string& contentType, const std::string& body) {
+        std::ostringstream out;
+        out << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+            << corsHeaders()
+            << "Content-Type: " << contentType << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n"
+            << body;
+        return sendRaw(out.str());
+    }
+    bool beginEventStream() {
+        std::ostringstream out;
+        out << "HTTP/1.1 200 OK\r\n"
+            << corsHeaders()
+            << "Content-Type: text/event-stream\r\n"
+            << "Cache-Control: no-cache\r\n"
+            << "Connection: close\r\n\r\n";
+        return sendRaw(out.str());
+    }
+    bool sendEvent(const std::string& event, const std::string& data) {
+        std::ostringstream out;
+        out << "event: " << event << "\n";
+        std::istringstream lines(data);
+        std::string line;
+        while (std::getline(lines, line)) {
+            out << "data: " << line << "\n";
+        }
+        out << "\n";
+        return sendRaw(out.str());
+    }
+
+    std::string corsHeaders() const {
+        if (allowedOrigin.empty()) {
+            return "";
+        }
+        return "Access-Control-Allow-Origin: " + allowedOrigin + "\r\n"
+               "Vary: Origin\r\n"
+               "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+               "Access-Control-Allow-Headers: Content-Type, X-Optimizer-Token\r\n";
+    }
+
+private:
+    static const char* statusText(int status) {
+        switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+        }
+    }
+
+    socket_handle socket;
+    std::string allowedOrigin;
+};
+
+class LocalHttpServer {
+public:
+    using Handler = std::function<void(const HttpRequest&, HttpConnection&)>;
+
+    // Requests other than CORS preflights must carry this value in X-Optimizer-Token.
+    // The Origin check alone is not enough: any page can send "Origin: null" from a
+    // sandboxed iframe.
+    void setAccessToken(const std::string& token) { accessToken = token; }
+
+    ~LocalHttpServer() {
+        if (listener != INVALID_SOCKET_HANDLE) {
+            closeSocketHandle(listener);
+        }
+#ifdef _WIN32
+        if (winsockStarted) {
+            WSACleanup();
+        }
+#endif
+    }
+
+    bool listen(unsigned short port) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            std::cerr << "Failed to initialise Winsock.\n";
+            return false;
+        }
+        winsockStarted = true;
+#endif
+        listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == INVALID_SOCKET_HANDLE) {
+            std::cerr << "Failed to create server socket.\n";
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "Failed to bind 127.0.0.1:" << port << " (port in use?)\n";
+            return false;
+        }
+        if (::listen(listener, 16) != 0) {
+            std::cerr << "Failed to listen on 127.0.0.1:" << port << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Accept loop; never returns while the listening socket is healthy.
+    void run(const Handler& handler) {
+        while (true) {
+            socket_handle client = ::accept(listener, nullptr, nullptr);
+            if (client == INVALID_SOCKET_HANDLE) {
+                continue;
+            }
+            // A client that never finishes its headers gives up its thread after the timeout.
+#ifdef _WIN32
+            const DWORD timeout = HTTP_READ_TIMEOUT_SECONDS * 1000;
+#else
+            timeval timeout{};
+            timeout.tv_sec = HTTP_READ_TIMEOUT_SECONDS;
+#endif
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            if (activeConnections.fetch_add(1) >= HTTP_MAX_CONNECTIONS) {
+                activeConnections.fetch_sub(1);
+                HttpConnection(client).sendResponse(503, "text/plain", "Too many connections\n");
+                closeSocketHandle(client);
+                continue;
+            }
+            std::thread([this, client, handler] {
+                HttpConnection connection(client);
+                HttpRequest request;
+                const int status = readRequest(client, request);
+                const std::string origin = request.header("origin");
+                if (status != 200) {
+                    connection.sendResponse(status, "text/plain", "Bad request\n");
+                } else if (!isLocalHost(request.header("host"))) {
+                    // Reject DNS-rebound pages that reach us under a foreign host name.
+                    connection.sendResponse(403, "text/plain", "Forbidden host\n");
+                } else if (!origin.empty() && !isAllowedOrigin(origin)) {
+                    // Any other web page could otherwise drive the optimizer and read its results.
+                    connection.sendResponse(403, "text/plain", "Forbidden origin\n");
+                } else {
+                    connection.setAllowedOrigin(origin);
+                    if (request.method == "OPTIONS") {
+                        connection.sendResponse(204, "text/plain", "");
+                    } else if (!tokenMatches(request.header("x-optimizer-token"))) {
+                        connection.sendResponse(403, "text/plain", "Missing or wrong X-Optimizer-Token\n");
+                    } else {
+                        handler(request, connection);
+                    }
+                }
+                closeSocketHandle(client);
+                activeConnections.fetch_sub(1);
+            }).detach();
+        }
+    }
+
+private:
+    static bool isLocalHost(const std::string& host) {
+        const std::string name = host.substr(0, host.rfind(':') == std::string::npos ? host.size() : host.rfind(':'));
+        return name == "127.0.0.1" || name == "localhost";
+    }
+    // Compares every byte so the time taken does not reveal the matching prefix.
+    bool tokenMatches(const std::string& token) const {
+        if (accessToken.empty()) {
+            return true;
+        }
+        if (token.size() != accessToken.size()) {
+            return false;
+        }
+        unsigned char difference = 0;
+        for (size_t i = 0; i < token.size(); i++) {
+            difference |= static_cast<unsigned char>(token[i] ^ accessToken[i]);
+        }
+        return difference == 0;
+    }
+    // "null" is what browsers send for the GUI opened from a file:// URL; otherwise
+    // only http(s) pages served from this machine may call us.
+    static bool isAllowedOrigin(const std::string& origin) {
+        if (origin == "null") {
+            return true;
+        }
+        std::string host;
+        if (origin.rfind("http://", 0) == 0) {
+            host = origin.substr(7);
+        } else if (origin.rfind("https://", 0) == 0) {
+            host = origin.substr(8);
+        } else {
+            return false;
+        }
+        const auto colon = host.find(':');
+        if (colon != std::string::npos) {
+            const std::string port = host.substr(colon + 1);
+            if (port.empty() || !std::all_of(port.begin(), port.end(), [](unsigned char c) { return std::isdigit(c); })) {
+                return false;
+            }
+        }
+        const std::string name = host.substr(0, colon);
+        return name == "127.0.0.1" || name == "localhost";
+    }
+
+    static int readRequest(socket_handle client, HttpRequest& request) {
+        std::string buffer;
+        char chunk[4096];
+        size_t headerEnd = std::string::npos;
+        while (headerEnd == std::string::npos) {
+            const auto n = ::recv(client, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return 400;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            headerEnd = buffer.find("\r\n\r\n");
+            if (headerEnd == std::string::npos && buffer.size() > HTTP_MAX_HEADER_BYTES) {
+                return 413;
+            }
+        }
+        std::istringstream head(buffer.substr(0, headerEnd));
+        std::string line;
+        std::getline(head, line);
+        std::istringstream requestLine(line);
+        std::string target;
+        requestLine >> request.method >> target;
+        const auto queryStart = target.find('?');
+        request.path = target.substr(0, queryStart);
+        if (queryStart != std::string::npos) {
+            request.query = target.substr(queryStart + 1);
+        }
+        while (std::getline(head, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            const auto colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, colon);
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            request.headers[key] = value;
+        }
+        size_t contentLength = 0;
+        try {
+            const std::string lengthText = request.header("content-length");
+            contentLength = lengthText.empty() ? 0 : static_cast<size_t>(std::stoull(lengthText));
+        } catch (...) {
+            return 400;
+        }
+        if (contentLength > HTTP_MAX_BODY_BYTES) {
+            return 413;
+        }
+        request.body = buffer.substr(headerEnd + 4);
+        while (request.body.size() < contentLength) {
+            const auto n = ::recv(client, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return 400;
+            }
+            request.body.append(chunk, static_cast<size_t>(n));
+        }
+        request.body.resize(contentLength);
+        return 200;
+    }
+
+    socket_handle listener = INVALID_SOCKET_HANDLE;
+    std::string accessToken;
+    std::atomic<int> activeConnections{0};
+#ifdef _WIN32
+    bool winsockStarted = false;
+#endif
+};
@@ -13,30 +13,29 @@
 #include <limits>
 #include <filesystem>
 #include <cmath>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 #include "constants.hpp"
 #include "config_loader.hpp"
+#include "result_file.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "counter_rng.hpp"
+#include "http_server.hpp"
 using namespace std;
 typedef long long ll;
 
-// ======================= EVENT DURATION (runtime) ======================
-int eventDurationDays = 14;
-int eventDurationHours = 0;
-int eventDurationMinutes = 0;
-int eventDurationSeconds = 0;
-
 // ======================= GLOBAL SETTINGS (runtime) =====================
-int UNLOCKED_PETS = 100;
-int DLs = 0;
 int outputInterval = 5000;
 
-double EVENT_CURRENCY_WEIGHT = 0.001;
-double FREE_EXP_WEIGHT = 0.00006;
-double PET_STONES_WEIGHT = 0.000045;
-double GROWTH_WEIGHT = 0.00007;
-
 bool isFullPath = true;
-bool allowSpeedUpgrades = true;
 bool runOptimization = true;
 bool logToConsoleEnabled = true;
 bool logToFileEnabled = false;
@@ -53,10 +52,103 @@ array<string, NUM_RESOURCES> resourceNames = {
     "Eye","PET_STONES","FREE_EXP","GROWTH","Black_Cat"
 };
 constexpr double INFINITY_VALUE = (1e100);
-int totalSeconds = ((14)*24*3600 + 0*3600 + 0*60 + 0);
+constexpr int DONT_LOOK_RADIUS = 2;                  // positions woken on each side of an accepted change
+constexpr double DONT_LOOK_TIME_SHIFT_SECONDS = 900; // completion-time shift that wakes a position
 
 map<int, string> upgradeNames;
-vector<double> timeNeededSeconds;
+
+// ======================= RUN SETTINGS ==================================
+// Seconds [start, end] of a busy window; an upgrade affordable at second s in
+// here is bought at windowEnd instead.
+struct BusySegment {
+    int start;
+    int end;
+    int windowEnd;
+};
+using BusySchedule = vector<BusySegment>;   // sorted, non-overlapping
+
+// Everything the simulation and search read for one run. Each run owns its
+// own copy, so server sessions with different configs can run side by side.
+struct RunSettings {
+    int totalSeconds = 14 * 24 * 3600;
+    int UNLOCKED_PETS = 100;
+    int DLs = 0;
+    double EVENT_CURRENCY_WEIGHT = 0.001;
+    double FREE_EXP_WEIGHT = 0.00006;
+    double PET_STONES_WEIGHT = 0.000045;
+    double GROWTH_WEIGHT = 0.00007;
+    bool allowSpeedUpgrades = true;
+    bool useDontLookBits = true;
+    bool useSymmetryReduction = true;
+    int selfCheckInterval = 0;          // compare every Nth evaluation against the reference simulator
+    bool useScoreBound = true;
+    double screeningTolerance = 0.0;    // 0 = every candidate is simulated to the end
+    int robustSamples = 0;              // sampled busy schedules to score against (0 = nominal only)
+    double robustJitterHours = 1.0;     // standard deviation of each window edge
+    double robustQuantile = -1.0;       // score quantile to maximise; negative = mean
+    unsigned robustSeed = 1;
+    uint64_t seed = 1;                  // root of every random stream the search uses
+    int memeticPopulation = 0;          // 0 = plain local search
+    int memeticGenerations = 20;
+    int memeticPolishIterations = 300;
+    int lnsWindow = 0;                  // 0 = no large-neighborhood rounds
+    int lnsRounds = 5;
+    int tabuIterations = 0;             // 0 = no tabu phase
+    int tabuTenure = 12;
+    int tabuCandidates = 128;
+    double upgradeReportTolerance = 0.001;
+    bool timeToTarget = false;          // minimise the time until every target is met instead of maximising the score
+    array<double, NUM_RESOURCES> targets{};   // resource goals for timeToTarget; 0 = no goal
+    vector<double> timeNeededSeconds;   // filled by preprocessBusyTimes
+    BusySchedule busySchedule;          // same windows in compact form, for the fast simulator
+    vector<BusySchedule> busyScenarios; // robust mode: perturbed schedules shared by every evaluation
+};
+RunSettings makeRunSettings(const AppConfig& cfg) {
+    RunSettings settings;
+    long long computedSeconds = static_cast<long long>(max(0, cfg.eventDurationDays)) * 24LL * 3600LL
+        + static_cast<long long>(max(0, cfg.eventDurationHours)) * 3600LL
+        + static_cast<long long>(max(0, cfg.eventDurationMinutes)) * 60LL
+        + static_cast<long long>(max(0, cfg.eventDurationSeconds));
+    if (computedSeconds <= 0) {
+        computedSeconds = 1;
+    }
+    settings.totalSeconds = static_cast<int>(min<long long>(computedSeconds, numeric_limits<int>::max()));
+    settings.UNLOCKED_PETS = cfg.UNLOCKED_PETS;
+    settings.DLs = cfg.DLs;
+    settings.EVENT_CURRENCY_WEIGHT = cfg.EVENT_CURRENCY_WEIGHT;
+    settings.FREE_EXP_WEIGHT = cfg.FREE_EXP_WEIGHT;
+    settings.PET_STONES_WEIGHT = cfg.PET_STONES_WEIGHT;
+    settings.GROWTH_WEIGHT = cfg.GROWTH_WEIGHT;
+    settings.allowSpeedUpgrades = cfg.allowSpeedUpgrades;
+    settings.useDontLookBits = cfg.useDontLookBits;
+    settings.useSymmetryReduction = cfg.useSymmetryReduction;
+    settings.selfCheckInterval = cfg.selfCheckInterval;
+    settings.robustSamples = cfg.robustSamples;
+    settings.robustJitterHours = cfg.robustJitterHours;
+    settings.robustQuantile = cfg.robustObjective == "quantile" ? cfg.robustQuantile : -1.0;
+    settings.robustSeed = static_cast<unsigned>(cfg.robustSeed);
+    settings.seed = cfg.seed != 0 ? static_cast<uint64_t>(cfg.seed) : (static_cast<uint64_t>(random_device{}()) << 32 | random_device{}());
+    settings.memeticPopulation = cfg.memeticPopulation;
+    settings.memeticGenerations = cfg.memeticGenerations;
+    settings.memeticPolishIterations = cfg.memeticPolishIterations;
+    settings.lnsWindow = cfg.lnsWindow;
+    settings.lnsRounds = cfg.lnsRounds;
+    settings.tabuIterations = cfg.tabuIterations;
+    settings.tabuTenure = cfg.tabuTenure;
+    settings.tabuCandidates = cfg.tabuCandidates;
+    settings.upgradeReportTolerance = cfg.upgradeReportTolerance;
+    settings.screeningTolerance = cfg.screeningTolerance;
+    settings.timeToTarget = cfg.objective == "timeToTarget";
+    for (int i = 0; i < NUM_RESOURCES && i < static_cast<int>(cfg.targetResources.size()); i++) {
+        settings.targets[i] = cfg.targetResources[i];
+    }
+    // The bound assumes more of every resource never lowers the score.
+    settings.useScoreBound = cfg.useScoreBound
+        && (settings.timeToTarget
+            || (settings.EVENT_CURRENCY_WEIGHT >= 0 && settings.FREE_EXP_WEIGHT >= 0
+                && settings.PET_STONES_WEIGHT >= 0 && settings.GROWTH_WEIGHT >= 0));
+    return settings;
+}
 
 // Vectors filled from config.json
 vector<int> currentLevels(21, 0);     // 10 level, 10 speed, 1 dummy
@@ -145,6 +237,7 @@ class Logger {
     mutable ofstream fileOut;
     bool logToFile = false;
     bool logToConsole = true;
+    function<void(const string&, const vector<int>&, double)> improvementListener;
 public:
     Logger(int outputInterval,
            bool enableConsole,
@@ -199,7 +292,15 @@ public:
             fileOut.flush();
         }
     }
+    // Called for every improvement regardless of the interval (used by the server mode).
+    void setImprovementListener(function<void(const string&, const vector<int>&, double)> listener) {
+        improvementListener = move(listener);
+    }
     void logImprovement(const string& type, vector<int>& path, const double score) const {
+        TraceZone zone("Log improvement");
+        if (improvementListener) {
+            improvementListener(type, path, score);
+        }
         auto now = chrono::steady_clock::now();
         auto elapsed = chrono::duration_cast<chrono::milliseconds>(now - lastLogTime).count();
         if (interval <= 0 || elapsed >= interval) {
@@ -216,12 +317,49 @@ struct SearchContext {
     Logger& logger;
     const vector<double>& resources;
     const vector<int>& levels;
+    const RunSettings& settings;
+    const atomic<bool>* cancelled = nullptr;   // set by the server when a client goes away
+    unsigned threads = 0;                       // workers for the parallel phases; 0 = one per core
+};
+// Batch and server jobs already run one per core, so their phases get a share of the machine.
+unsigned searchThreads(const SearchContext& context) {
+    return context.threads > 0 ? context.threads : max(1u, thread::hardware_concurrency());
+}
+// Fast-simulator state at one point of a path.
+struct SimulationState {
+    array<int, NUM_RESOURCES * 2 + 1> levels{};
+    array<double, NUM_RESOURCES> resources{};
+    array<double, NUM_RESOURCES> rates{};   // production per second, kept in sync with levels
+    double time = 0.0;                      // seconds left in the event
+    double targetsMetAt = -1.0;             // timeToTarget: elapsed seconds when every target was met, -1 = not yet
+    const BusySchedule* busy = nullptr;     // schedule this state is simulated under
+};
+using UpgradeCounts = array<int, NUM_RESOURCES * 2 + 1>;
+struct BoundStats {
+    long long candidates = 0;
+    long long pruned = 0;
+    long long stepsSimulated = 0;
+    long long stepsReused = 0;            // prefix steps taken from checkpoints instead of simulated
+    long long stepsPruned = 0;            // steps left unsimulated because the bound ruled the candidate out
+    long long screened = 0;               // candidates dropped by the truncated-horizon screen
+    long long stepsScreened = 0;          // steps left unsimulated because of the screen
+    long long screenAudits = 0;           // screened candidates simulated to the end anyway
+    long long screenFalseRejects = 0;     // audited candidates that would have beaten the incumbent
+    long long commuting = 0;              // swaps/rotations skipped because they only reorder a commuting run
 };
 struct OptimizationPackage {
     vector<int> path;
     double score;
-    mt19937 randomEngine;
+    CounterRng randomEngine;
     unordered_set<string> deadMoves = {};
+    vector<char> dontLookSwap = {};       // per-position don't-look bits of the swap sweep, aligned with path
+    vector<char> dontLookRotate = {};     // same for the rotation sweep; a failed swap row says nothing about rotations
+    vector<double> completionTimes = {};  // elapsed seconds after each path entry, aligned with path
+    vector<int> checkpointPath = {};      // path the checkpoints below were built for
+    vector<SimulationState> checkpoints = {};   // state before each path entry (and after the last), one per scenario
+    vector<UpgradeCounts> suffixCounts = {};    // upgrades from each position to the end
+    vector<int> commutingRun = {};        // per position: first position of its commuting run, or -1
+    BoundStats boundStats = {};
 };
 struct Proposal {
     string type;
@@ -243,6 +381,59 @@ struct Proposal {
         return Proposal{"Rotate", score, indexA, indexB, rotateIndex, 0};
     }
 };
+// A candidate move described relative to the current path. The evaluator reads
+// the edited path through upgradeAt, so scanning a neighborhood never copies the
+// path; apply() changes it once a move is accepted.
+struct PathEdit {
+    enum Kind { Insert, Remove, Swap, Rotate };
+    Kind kind;
+    int a = 0;        // Insert/Remove position, first swapped position, or start of the rotated range
+    int b = 0;        // second swapped position, or one past the end of the rotated range
+    int pivot = 0;    // Rotate: position that moves to a (std::rotate's middle)
+    int upgrade = 0;  // Insert: upgrade type
+    static PathEdit insertAt(int position, int upgradeType) { return PathEdit{Insert, position, 0, 0, upgradeType}; }
+    static PathEdit removeAt(int position) { return PathEdit{Remove, position, 0, 0, 0}; }
+    static PathEdit swapAt(int first, int second) { return PathEdit{Swap, min(first, second), max(first, second), 0, 0}; }
+    static PathEdit rotateRange(int first, int middle, int last) { return PathEdit{Rotate, first, last, middle, 0}; }
+
+    int divergeAt() const { return a; }
+    // First position from which the edited path repeats base, shifted by baseOffset().
+    int realignAt() const {
+        switch (kind) {
+        case Insert: return a + 1;
+        case Remove: return a;
+        case Swap:   return b + 1;
+        case Rotate: return b;
+        }
+        return a;
+    }
+    int baseOffset() const { return kind == Insert ? -1 : kind == Remove ? 1 : 0; }
+    int length(int baseLength) const {
+        return baseLength + (kind == Insert ? 1 : 0) - (kind == Remove ? 1 : 0);
+    }
+    int upgradeAt(const vector<int>& base, int k) const {
+        if (k < a) return base[k];
+        switch (kind) {
+        case Insert: return k == a ? upgrade : base[k - 1];
+        case Remove: return base[k + 1];
+        case Swap:   return k == a ? base[b] : k == b ? base[a] : base[k];
+        case Rotate: return k < b ? base[a + (k - a + pivot - a) % (b - a)] : base[k];
+        }
+        return base[k];
+    }
+    void apply(vector<int>& path) const {
+        switch (kind) {
+        case Insert: path.insert(path.begin() + a, upgrade); break;
+        case Remove: path.erase(path.begin() + a); break;
+        case Swap:   swap(path[a], path[b]); break;
+        case Rotate: rotate(path.begin() + a, path.begin() + pivot, path.begin() + b); break;
+        }
+    }
+    void materialize(const vector<int>& base, vector<int>& out) const {
+        out = base;
+        apply(out);
+    }
+};
 void nameUpgrades() {
     for (int i = 0; i < NUM_RESOURCES; i++) {
         upgradeNames[i] = string(resourceNames[i]) + "_Level";
@@ -250,13 +441,13 @@ void nameUpgrades() {
     }
     upgradeNames[20] = "Complete";
 }
-void adjustFullPath(const vector<int>& startingLevels){ // not thread-safe
+void adjustFullPath(vector<int>& path, const vector<int>& startingLevels){
     vector<int> levels = startingLevels;
     if (levels.size() > 1 && levels[1] > 0) {
         levels[1]--; // Adjust first level because it always starts at 1
     }
-    auto it = upgradePath.begin();
-    while (it != upgradePath.end()) {
+    auto it = path.begin();
+    while (it != path.end()) {
         const int upgrade = *it;
         if (upgrade < 0 || upgrade >= static_cast<int>(levels.size())) {
             ++it;
@@ -264,16 +455,54 @@ void adjustFullPath(const vector<int>& startingLevels){ // not thread-safe
         }
         if (levels[upgrade] > 0) {
             levels[upgrade]--;
-            it = upgradePath.erase(it);
+            it = path.erase(it);
         } else {
             ++it;
         }
     }
-    if (upgradePath.empty() || upgradePath.back() != NUM_RESOURCES * 2) {
-        upgradePath.push_back(NUM_RESOURCES * 2);
+    if (path.empty() || path.back() != NUM_RESOURCES * 2) {
+        path.push_back(NUM_RESOURCES * 2);
+    }
+}
+// Strips upgrades bought since the previous plan started, leaving the part still to do.
+vector<int> remainingPlanSuffix(const PlanResult& previous, const vector<int>& levelsNow) {
+    vector<int> bought(levelsNow.size(), 0);
+    for (size_t i = 0; i < levelsNow.size(); ++i) {
+        const int before = i < previous.startLevels.size() ? previous.startLevels[i] : 0;
+        bought[i] = max(0, levelsNow[i] - before);
+    }
+    vector<int> suffix;
+    suffix.reserve(previous.upgradePath.size());
+    for (int upgrade : previous.upgradePath) {
+        if (upgrade >= 0 && upgrade < static_cast<int>(bought.size()) && bought[upgrade] > 0) {
+            bought[upgrade]--;
+            continue;
+        }
+        suffix.push_back(upgrade);
+    }
+    if (suffix.empty() || suffix.back() != NUM_RESOURCES * 2) {
+        suffix.push_back(NUM_RESOURCES * 2);
     }
+    return suffix;
 }
-string formatResultsReport(const vector<int>& path,
+// Moves busy windows (hours from launch) so they are measured from elapsedHours instead.
+void shiftBusyWindows(vector<double>& startHours, vector<double>& endHours, double elapsedHours) {
+    vector<double> shiftedStart;
+    vector<double> shiftedEnd;
+    for (size_t i = 0; i < startHours.size() && i < endHours.size(); ++i) {
+        const double start = startHours[i] - elapsedHours;
+        const double end = endHours[i] - elapsedHours;
+        if (max(start, end) <= 0.0) {
+            continue;
+        }
+        shiftedStart.push_back(max(0.0, min(start, end)));
+        shiftedEnd.push_back(max(start, end));
+    }
+    startHours.swap(shiftedStart);
+    endHours.swap(shiftedEnd);
+}
+string formatResultsReport(const RunSettings& settings,
+                          const vector<int>& path,
                           const vector<int>& simulationLevels,
                           const vector<double>& simulationResources,
                           double finalScore) {
@@ -288,17 +517,84 @@ string formatResultsReport(const vector<int>& path,
     printVector(simulationLevels, out);
     out << "\n";
     out << "Event Currency: " << min(simulationResources[9], EVENT_CURRENCY_CAP) << "\n";
-    out << "Free Exp (" << DLs << " DLs): "
-        << simulationResources[7] * (500.0 + DLs) / 5.0
+    out << "Free Exp (" << settings.DLs << " DLs): "
+        << simulationResources[7] * (500.0 + settings.DLs) / 5.0
         << " (" << simulationResources[7] << " levels * cycles)" << "\n";
     out << "Pet Stones: " << simulationResources[6] << "\n";
-    out << "Growth (" << UNLOCKED_PETS << " pets): "
-        << simulationResources[8] * UNLOCKED_PETS / 100.0
+    out << "Growth (" << settings.UNLOCKED_PETS << " pets): "
+        << simulationResources[8] * settings.UNLOCKED_PETS / 100.0
         << " (" << simulationResources[8] << " levels * cycles)" << "\n";
+    if (settings.timeToTarget) {
+        if (finalScore >= -settings.totalSeconds / 3600.0) {
+            out << "Targets met after: " << -finalScore << " h\n";
+        } else {
+            out << "Targets not met before the event ends\n";
+        }
+    }
     out << "Score: " << finalScore << "\n\n";
     return out.str();
 }
-void preprocessBusyTimes(const vector<double>& startHours, const vector<double>& endHours) {
+// Same clamping and "later window wins" overlap rule as the per-second table.
+BusySchedule makeBusySchedule(int totalSeconds, const vector<double>& startHours, const vector<double>& endHours) {
+    BusySchedule schedule;
+    BusySchedule painted;
+    for (size_t i = 0; i < startHours.size() && i < endHours.size(); ++i) {
+        int startSec = clamp(static_cast<int>(startHours[i] * 3600.0), 0, max(0, totalSeconds - 1));
+        int endSec = clamp(static_cast<int>(endHours[i] * 3600.0), 0, max(0, totalSeconds - 1));
+        if (endSec < startSec) {
+            swap(startSec, endSec);
+        }
+        painted.clear();
+        for (const BusySegment& segment : schedule) {
+            if (segment.end < startSec || segment.start > endSec) {
+                painted.push_back(segment);
+                continue;
+            }
+            if (segment.start < startSec) painted.push_back({segment.start, startSec - 1, segment.windowEnd});
+            if (segment.end > endSec) painted.push_back({endSec + 1, segment.end, segment.windowEnd});
+        }
+        painted.push_back({startSec, endSec, endSec});
+        sort(painted.begin(), painted.end(), [](const BusySegment& a, const BusySegment& b) { return a.start < b.start; });
+        schedule.swap(painted);
+    }
+    return schedule;
+}
+inline double busyDelay(const BusySchedule& schedule, int second) {
+    auto it = upper_bound(schedule.begin(), schedule.end(), second,
+                          [](int s, const BusySegment& segment) { return s < segment.start; });
+    if (it == schedule.begin()) return 0.0;
+    --it;
+    return second <= it->end ? it->windowEnd - second : 0.0;
+}
+// Streams drawn from RunSettings::seed; each use gets its own so adding draws
+// in one place never shifts another.
+enum RandomStream : uint64_t { STREAM_START_PATH = 1, STREAM_SEARCH = 2, STREAM_ROBUST_SCENARIOS = 3 };
+
+// Builds the compact schedule and, in robust mode, the perturbed schedules. The
+// perturbations come from one stream of the run seed (robustSeed picks a child
+// stream), so every candidate is scored against the same samples and a seeded
+// run always faces the same ones.
+void buildBusySchedules(RunSettings& settings, const vector<double>& startHours, const vector<double>& endHours) {
+    settings.busySchedule = makeBusySchedule(settings.totalSeconds, startHours, endHours);
+    settings.busyScenarios.clear();
+    CounterRng rng = CounterRng(settings.seed, STREAM_ROBUST_SCENARIOS).stream(settings.robustSeed);
+    const double deviation = max(0.0, settings.robustJitterHours);
+    auto jitter = [&] { return deviation * rng.normal(); };
+    vector<double> sampledStart, sampledEnd;
+    for (int sample = 0; sample < settings.robustSamples; sample++) {
+        sampledStart = startHours;
+        sampledEnd = endHours;
+        for (size_t i = 0; i < sampledStart.size() && i < sampledEnd.size(); ++i) {
+            sampledStart[i] += jitter();
+            sampledEnd[i] += jitter();
+            if (sampledEnd[i] < sampledStart[i]) sampledEnd[i] = sampledStart[i];
+        }
+        settings.busyScenarios.push_back(makeBusySchedule(settings.totalSeconds, sampledStart, sampledEnd));
+    }
+}
+void preprocessBusyTimes(RunSettings& settings, const vector<double>& startHours, const vector<double>& endHours) {
+    const int totalSeconds = settings.totalSeconds;
+    vector<double>& timeNeededSeconds = settings.timeNeededSeconds;
     if (static_cast<int>(timeNeededSeconds.size()) != totalSeconds) {
         timeNeededSeconds.assign(max(1, totalSeconds), 0.0);
     } else {
@@ -316,19 +612,22 @@ void preprocessBusyTimes(const vector<double>& startHours, const vector<double>&
             timeNeededSeconds[s] = endSec - s;
         }
     }
+    buildBusySchedules(settings, startHours, endHours);
 }
-inline double additionalTimeNeeded(double expectedTimeSeconds) {
+inline double additionalTimeNeeded(const RunSettings& settings, double expectedTimeSeconds) {
     int idx = static_cast<int>(expectedTimeSeconds);
-    if (idx < 0 || idx >= static_cast<int>(timeNeededSeconds.size())) return 0.0;
-    return timeNeededSeconds[idx];
+    if (idx < 0 || idx >= static_cast<int>(settings.timeNeededSeconds.size())) return 0.0;
+    return settings.timeNeededSeconds[idx];
 }
-vector <int> generateRandomPath(int length = -1) {
+template <typename Rng>
+vector <int> generateRandomPath(const RunSettings& settings, Rng& rng, int length = -1) {
     if (length < 0) {
-        length = max(1, totalSeconds / 3600);
+        length = max(1, settings.totalSeconds / 3600);
     }
     vector<int> randomPath = {};
+    const int speedChoices = settings.allowSpeedUpgrades ? 2 : 1;
     for (int i = 0; i < length; i++) {
-        randomPath.push_back(rand() % NUM_RESOURCES + 10 * (rand() % 2));
+        randomPath.push_back(rng() % NUM_RESOURCES + 10 * (rng() % speedChoices));
     }
     randomPath.push_back(NUM_RESOURCES * 2);
     return randomPath;
@@ -350,7 +649,10 @@ inline void clampEventCurrency(vector<double>& resources) {
 }
 
 // =================== ALGORITHM FUNCTIONS ===============================
-double performUpgrade(vector<int>& levels, vector<double>& resources, int upgradeType, double& remainingTime) {
+// Reference simulator: the original straightforward implementation. The search
+// uses the fast simulator below; --diff-check and selfCheckInterval compare the
+// two, so keep this one simple and change it only when the game rules change.
+double referencePerformUpgrade(const RunSettings& settings, vector<int>& levels, vector<double>& resources, int upgradeType, double& remainingTime) {
     if (upgradeType >= NUM_RESOURCES && upgradeType < NUM_RESOURCES * 2) {
         if (levels[upgradeType] >= SPEED_LEVEL_CAP) {
             return 0.0;
@@ -429,6 +731,7 @@ double performUpgrade(vector<int>& levels, vector<double>& resources, int upgrad
     productionRates[9] = levels[9] * cycleTimeMultiplier[9] * speedMultipliers[levels[19]];
 
     double timeNeeded = 0;
+    const int totalSeconds = settings.totalSeconds;
     double timeElapsed = totalSeconds - remainingTime;
     for (int i = 0; i < NUM_RESOURCES; i++) {
         double neededResources = cost[i] - resources[i];
@@ -441,7 +744,7 @@ double performUpgrade(vector<int>& levels, vector<double>& resources, int upgrad
     }
     int busyLookupIndex = static_cast<int>(timeElapsed + timeNeeded);
     if (0 <= busyLookupIndex && busyLookupIndex < totalSeconds){
-        timeNeeded += timeNeededSeconds[busyLookupIndex];
+        timeNeeded += settings.timeNeededSeconds[busyLookupIndex];
     };
 
     if (timeNeeded >= remainingTime || upgradeType == (2 * NUM_RESOURCES)) {
@@ -460,60 +763,473 @@ double performUpgrade(vector<int>& levels, vector<double>& resources, int upgrad
     clampEventCurrency(resources);
     return timeNeeded;
 }
-double simulateUpgradePath(vector<int>& path,
+double referenceSimulateUpgradePath(const RunSettings& settings,
+                                   const vector<int>& path,
+                                   vector<int>& levels,
+                                   vector<double>& resources) {
+    double time = settings.totalSeconds;
+    for (auto upgradeType : path) {
+        if (time < 1e-3) return 0;
+        if (upgradeType >= NUM_RESOURCES && levels[upgradeType] >= SPEED_LEVEL_CAP) {
+            continue; // Skip speed upgrades that are already maxed out
+        }
+        time -= referencePerformUpgrade(settings, levels, resources, upgradeType, time);
+    }
+    return time;
+}
+
+// Fast simulator: same rules on fixed-size arrays, with production rates kept
+// up to date per level change instead of rebuilt for every upgrade.
+constexpr double CYCLE_TIME_MULTIPLIERS[NUM_RESOURCES] = {
+    1.0/3.0, 1.0, 1.0/3.0, 1.0/3.0, 1.0/3.0,
+    1.0/3.0, 1.0/1200.0, 1.0/2500.0, 1.0/1800.0, 1.0/5000.0
+};
+constexpr double SPEED_MULTIPLIERS[SPEED_LEVEL_CAP + 1] = {
+    1.0, 1.25, 1.5625, 1.953125, 2.44140625, 3.0517578125,
+    3.814697265625, 4.76837158203125, 5.960464477539063,
+    7.450580596923828, 9.313225746154785
+};
+// Multiple of the base cost paid in each resource (columns) per upgraded resource (rows).
+constexpr double COST_SHARES[NUM_RESOURCES][NUM_RESOURCES] = {
+    {0.0, 10.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 0.8,  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 1.0,  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 1.0,  1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 1.0,  1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {1.0, 0.0,  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.7, 0.0,  0.0, 0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {1.0, 0.0,  0.0, 0.0, 3.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 0.0,  1.2, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0},
+    {0.0, 0.0,  0.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0, 0.0},
+};
+inline double productionRate(const SimulationState& state, int resource) {
+    return state.levels[resource] * CYCLE_TIME_MULTIPLIERS[resource] * SPEED_MULTIPLIERS[state.levels[resource + NUM_RESOURCES]];
+}
+SimulationState makeSimulationState(const RunSettings& settings, const vector<int>& levels, const vector<double>& resources) {
+    SimulationState state;
+    for (size_t i = 0; i < state.levels.size() && i < levels.size(); ++i) state.levels[i] = levels[i];
+    for (size_t i = 0; i < state.resources.size() && i < resources.size(); ++i) state.resources[i] = resources[i];
+    for (int i = 0; i < NUM_RESOURCES; i++) state.rates[i] = productionRate(state, i);
+    state.time = settings.totalSeconds;
+    state.busy = &settings.busySchedule;
+    return state;
+}
+void storeSimulationState(const SimulationState& state, vector<int>& levels, vector<double>& resources) {
+    for (size_t i = 0; i < state.levels.size() && i < levels.size(); ++i) levels[i] = state.levels[i];
+    for (size_t i = 0; i < state.resources.size() && i < resources.size(); ++i) resources[i] = state.resources[i];
+}
+// Seconds until every target is met at the current production rates: 0 if it
+// already is, INFINITY_VALUE if some target is not produced at all.
+inline double secondsToTargets(const RunSettings& settings, const SimulationState& state) {
+    double wait = 0.0;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        const double missing = settings.targets[i] - state.resources[i];
+        if (settings.targets[i] <= 0 || missing <= 0) continue;
+        if (state.rates[i] == 0) return INFINITY_VALUE;
+        wait = max(wait, missing / state.rates[i]);
+    }
+    return wait;
+}
+// Buys one upgrade (or runs out the clock) and returns the seconds it took.
+inline double advanceUpgrade(const RunSettings& settings, SimulationState& state, int upgradeType) {
+    const bool isSpeed = upgradeType >= NUM_RESOURCES && upgradeType < NUM_RESOURCES * 2;
+    if (isSpeed && state.levels[upgradeType] >= SPEED_LEVEL_CAP) {
+        return 0.0;
+    }
+    const double remainingTime = state.time;
+    double timeNeeded = remainingTime;
+    double cost[NUM_RESOURCES] = {};
+    if (upgradeType != NUM_RESOURCES * 2) {
+        const int newLevel = state.levels[upgradeType] + 1;
+        double baseCost = (3.0 * newLevel * newLevel * newLevel + 1.0) * 100.0;
+        if (isSpeed) baseCost *= 2.0;
+        const double* shares = COST_SHARES[upgradeType % NUM_RESOURCES];
+        timeNeeded = 0;
+        for (int i = 0; i < NUM_RESOURCES; i++) {
+            cost[i] = baseCost * shares[i];
+            double neededResources = cost[i] - state.resources[i];
+            if (neededResources <= 0) continue;
+            if (state.rates[i] == 0) {
+                timeNeeded = INFINITY_VALUE;
+                break;
+            }
+            timeNeeded = max(timeNeeded, neededResources / state.rates[i]);
+        }
+        if (timeNeeded < remainingTime) {
+            const double timeElapsed = settings.totalSeconds - remainingTime;
+            const int busyLookupIndex = static_cast<int>(timeElapsed + timeNeeded);
+            if (0 <= busyLookupIndex && busyLookupIndex < settings.totalSeconds) {
+                timeNeeded += busyDelay(*state.busy, busyLookupIndex);
+            }
+        }
+    }
+    // In timeToTarget mode nothing after the targets are met can change the
+    // objective, so the state ends the event right there and every simulation
+    // loop stops.
+    if (settings.timeToTarget && state.targetsMetAt < 0) {
+        const double wait = secondsToTargets(settings, state);
+        if (wait <= min(timeNeeded, remainingTime)) {
+            for (int i = 0; i < NUM_RESOURCES; i++) {
+                state.resources[i] += state.rates[i] * wait;
+            }
+            state.resources[9] = min(state.resources[9], EVENT_CURRENCY_CAP);
+            state.targetsMetAt = settings.totalSeconds - remainingTime + wait;
+            state.time = 0.0;
+            return remainingTime;
+        }
+    }
+    if (timeNeeded >= remainingTime || upgradeType == NUM_RESOURCES * 2) {
+        timeNeeded = remainingTime;
+        for (int i = 0; i < NUM_RESOURCES; i++) {
+            state.resources[i] += state.rates[i] * timeNeeded;
+        }
+        state.resources[9] = min(state.resources[9], EVENT_CURRENCY_CAP);
+        state.time -= timeNeeded;
+        return timeNeeded;
+    }
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        state.resources[i] += state.rates[i] * timeNeeded - cost[i];
+    }
+    state.levels[upgradeType]++;
+    const int resource = upgradeType % NUM_RESOURCES;
+    state.rates[resource] = productionRate(state, resource);
+    state.resources[9] = min(state.resources[9], EVENT_CURRENCY_CAP);
+    state.time -= timeNeeded;
+    return timeNeeded;
+}
+inline void simulatePathFast(const RunSettings& settings, const vector<int>& path, SimulationState& state) {
+    for (int upgradeType : path) {
+        if (state.time < 1e-3) return;
+        if (upgradeType >= NUM_RESOURCES && state.levels[upgradeType] >= SPEED_LEVEL_CAP) {
+            continue; // Skip speed upgrades that are already maxed out
+        }
+        advanceUpgrade(settings, state, upgradeType);
+    }
+}
+// ------------ Robust scoring ------------
+// In robust mode every path is simulated once per sampled busy schedule, all
+// scenarios stepping through the path together, and the scores are reduced to
+// their mean or a quantile.
+inline int scenarioCount(const RunSettings& settings) {
+    return settings.busyScenarios.empty() ? 1 : static_cast<int>(settings.busyScenarios.size());
+}
+void makeScenarioStates(const RunSettings& settings,
+                        const vector<int>& levels,
+                        const vector<double>& resources,
+                        vector<SimulationState>& states) {
+    const SimulationState start = makeSimulationState(settings, levels, resources);
+    states.assign(scenarioCount(settings), start);
+    for (size_t s = 0; s < settings.busyScenarios.size(); ++s) {
+        states[s].busy = &settings.busyScenarios[s];
+    }
+}
+// Applies one path entry to every scenario; returns how many still have time left.
+inline int advanceScenarios(const RunSettings& settings, SimulationState* states, int count, int upgradeType) {
+    int active = 0;
+    for (int s = 0; s < count; s++) {
+        SimulationState& state = states[s];
+        if (state.time < 1e-3) continue;
+        if (!(upgradeType >= NUM_RESOURCES && state.levels[upgradeType] >= SPEED_LEVEL_CAP)) {
+            advanceUpgrade(settings, state, upgradeType);
+        }
+        if (state.time >= 1e-3) active++;
+    }
+    return active;
+}
+// Mean of values, or the robustQuantile-th one in robust quantile mode. Reorders values.
+double aggregateScenarios(const RunSettings& settings, vector<double>& values) {
+    if (values.size() == 1) {
+        return values[0];
+    }
+    if (settings.robustQuantile < 0) {
+        double sum = 0.0;
+        for (double value : values) sum += value;
+        return sum / values.size();
+    }
+    const size_t rank = static_cast<size_t>(floor(settings.robustQuantile * (values.size() - 1)));
+    nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+double simulateUpgradePath(const RunSettings& settings,
+                          const vector<int>& path,
                           vector<int>& levels,
                           vector<double>& resources,
                           bool display = false,
                           vector<string>* upgradeLog = nullptr) {
-    thread_local double time;
-    time = totalSeconds;
+    const int totalSeconds = settings.totalSeconds;
+    SimulationState state = makeSimulationState(settings, levels, resources);
     for (auto upgradeType : path) {
-        if (time < 1e-3) return 0;
-        if (upgradeType >= NUM_RESOURCES && levels[upgradeType] >= SPEED_LEVEL_CAP) {
+        if (state.time < 1e-3) {
+            storeSimulationState(state, levels, resources);
+            return 0;
+        }
+        if (upgradeType >= NUM_RESOURCES && state.levels[upgradeType] >= SPEED_LEVEL_CAP) {
             continue; // Skip speed upgrades that are already maxed out
         }
-        double timeTaken = performUpgrade(levels, resources, upgradeType, time);
-        time -= timeTaken;
-        if (display) {
-            const int elapsedSeconds = static_cast<int>(totalSeconds - time);
-            const string line = formatUpgradeReadout(upgradeType, levels, elapsedSeconds);
-            cout << line << "\n";
+        advanceUpgrade(settings, state, upgradeType);
+        if (state.targetsMetAt >= 0) {
+            break;   // met before this entry was bought; the rest of the path doesn't count
+        }
+        if (display || upgradeLog) {
+            const int elapsedSeconds = static_cast<int>(totalSeconds - state.time);
+            vector<int> levelView(state.levels.begin(), state.levels.end());
+            const string line = formatUpgradeReadout(upgradeType, levelView, elapsedSeconds);
+            if (display) {
+                cout << line << "\n";
+            }
             if (upgradeLog) {
                 upgradeLog->push_back(line);
             }
-        } else if (upgradeLog) {
-            const int elapsedSeconds = static_cast<int>(totalSeconds - time);
-            upgradeLog->push_back(formatUpgradeReadout(upgradeType, levels, elapsedSeconds));
         }
     }
-    return time;
+    storeSimulationState(state, levels, resources);
+    return state.time;
 }
-double calculateScore(vector<double>& resources, bool display = false) {
+template <typename Resources>
+double calculateScore(const RunSettings& settings, const Resources& resources, bool display = false) {
     double score = 0;
     for (int i = 0; i < NUM_RESOURCES; i++) {
         score += resources[i] * 1e-15;
     }
     const double cappedEventCurrency = min(resources[9], EVENT_CURRENCY_CAP);
-    score += (cappedEventCurrency + max(0.0, (resources[9] - EVENT_CURRENCY_CAP)) * 0.01) * (EVENT_CURRENCY_WEIGHT);
-    score += resources[7] * (FREE_EXP_WEIGHT);     // Free EXP
-    score += resources[8] * (GROWTH_WEIGHT);       // Growth
-    score += resources[6] * (PET_STONES_WEIGHT);   // Pet Stones
+    score += (cappedEventCurrency + max(0.0, (resources[9] - EVENT_CURRENCY_CAP)) * 0.01) * (settings.EVENT_CURRENCY_WEIGHT);
+    score += resources[7] * (settings.FREE_EXP_WEIGHT);     // Free EXP
+    score += resources[8] * (settings.GROWTH_WEIGHT);       // Growth
+    score += resources[6] * (settings.PET_STONES_WEIGHT);   // Pet Stones
     return score;
 }
-double evaluatePath(vector<int>& path, const SearchContext& context){
+constexpr double TARGET_IDLE_PENALTY = 1e-3;   // share of the event length, at zero levels
+
+// Minus the hours until every target was met. A path that ends early keeps
+// producing without purchases. Targets still missed when the event ends score
+// below minus the event length by their mean relative shortfall, plus a small
+// penalty that shrinks with every level held, so the search still has a slope
+// to climb while no target is produced at all.
+double timeToTargetScore(const RunSettings& settings, const SimulationState& state) {
+    double metAt = state.targetsMetAt;
+    if (metAt < 0) {
+        const double wait = secondsToTargets(settings, state);
+        if (wait <= state.time) metAt = settings.totalSeconds - state.time + wait;
+    }
+    if (metAt >= 0) {
+        return -metAt / 3600.0;
+    }
+    double shortfall = 0.0;
+    int targets = 0;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (settings.targets[i] <= 0) continue;
+        double reached = state.resources[i] + state.rates[i] * state.time;
+        if (i == 9) reached = min(reached, EVENT_CURRENCY_CAP);
+        shortfall += max(0.0, 1.0 - reached / settings.targets[i]);
+        targets++;
+    }
+    int totalLevels = 0;
+    for (int t = 0; t < NUM_RESOURCES * 2; t++) totalLevels += state.levels[t];
+    const double idle = TARGET_IDLE_PENALTY / (1.0 + max(0, totalLevels));
+    return -settings.totalSeconds / 3600.0 * (1.0 + shortfall / max(1, targets) + idle);
+}
+// What the search maximises for a simulated state.
+inline double objectiveScore(const RunSettings& settings, const SimulationState& state) {
+    return settings.timeToTarget ? timeToTargetScore(settings, state) : calculateScore(settings, state.resources);
+}
+constexpr int ROBUST_PARALLEL_MIN_SCENARIOS = 4;
+// Shared by full robust evaluations made outside the parallel phases; its workers
+// only simulate, so they never wait on the pool themselves.
+ThreadPool& scenarioPool() {
+    static ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
+void simulateScenarioScores(const RunSettings& settings,
+                            const vector<int>& path,
+                            const vector<int>& levels,
+                            const vector<double>& resources,
+                            vector<double>& scores) {
+    thread_local vector<SimulationState> states;
+    makeScenarioStates(settings, levels, resources, states);
+    const int count = static_cast<int>(states.size());
+    SimulationState* const scenarioStates = states.data();   // states is thread_local: pass it to workers by pointer
+    auto simulateRange = [&](int first, int last) {
+        for (int upgradeType : path) {
+            if (advanceScenarios(settings, scenarioStates + first, last - first, upgradeType) == 0) break;
+        }
+    };
+    // Scenarios are independent, so splitting them leaves every score unchanged.
+    // Inside memetic, tabu, LNS, batch or server workers the cores are already busy.
+    const int chunks = count < ROBUST_PARALLEL_MIN_SCENARIOS || ThreadPool::onWorkerThread()
+        ? 1 : min(count, static_cast<int>(scenarioPool().size()));
+    if (chunks > 1) {
+        scenarioPool().runBatch(chunks, [&](size_t chunk) {
+            simulateRange(static_cast<int>(chunk) * count / chunks, static_cast<int>(chunk + 1) * count / chunks);
+        });
+    } else {
+        simulateRange(0, count);
+    }
+    scores.resize(count);
+    for (int s = 0; s < count; s++) scores[s] = objectiveScore(settings, states[s]);
+}
+double scoreRobust(const RunSettings& settings,
+                   const vector<int>& path,
+                   const vector<int>& levels,
+                   const vector<double>& resources) {
+    thread_local vector<double> scores;
+    simulateScenarioScores(settings, path, levels, resources, scores);
+    return aggregateScenarios(settings, scores);
+}
+string formatRobustReport(const RunSettings& settings,
+                          const vector<int>& path,
+                          const vector<int>& levels,
+                          const vector<double>& resources) {
+    vector<double> scores;
+    simulateScenarioScores(settings, path, levels, resources, scores);
+    SimulationState nominal = makeSimulationState(settings, levels, resources);
+    simulatePathFast(settings, path, nominal);
+    sort(scores.begin(), scores.end());
+    double mean = 0.0;
+    for (double score : scores) mean += score;
+    mean /= scores.size();
+    double variance = 0.0;
+    for (double score : scores) variance += (score - mean) * (score - mean);
+    const double deviation = sqrt(variance / scores.size());
+    auto quantile = [&](double q) { return scores[static_cast<size_t>(floor(q * (scores.size() - 1)))]; };
+    vector<double> objective = scores;
+    ostringstream out;
+    out << "Robust score over " << scores.size() << " sampled busy schedules (edge jitter "
+        << settings.robustJitterHours << " h):\n"
+        << "  nominal " << objectiveScore(settings, nominal) << ", mean " << mean << ", sd " << deviation << "\n"
+        << "  min " << scores.front() << ", p10 " << quantile(0.1) << ", median " << quantile(0.5)
+        << ", p90 " << quantile(0.9) << ", max " << scores.back() << "\n"
+        << "  objective (";
+    if (settings.robustQuantile < 0) {
+        out << "mean";
+    } else {
+        out << "quantile " << settings.robustQuantile;
+    }
+    out << "): " << aggregateScenarios(settings, objective) << "\n";
+    return out.str();
+}
+// ------------ Differential checking ------------
+constexpr double DIFF_CHECK_TOLERANCE = 1e-9;   // relative, on resources and score
+atomic<long long> selfCheckSamples{0};
+atomic<long long> selfCheckMismatches{0};
+
+bool nearlyEqual(double a, double b, double tolerance = DIFF_CHECK_TOLERANCE) {
+    return fabs(a - b) <= tolerance * max({1.0, fabs(a), fabs(b)});
+}
+// Simulates path with both simulators from the same start and describes the first difference (empty if none).
+string compareSimulators(const RunSettings& settings,
+                         const vector<int>& path,
+                         const vector<int>& startLevels,
+                         const vector<double>& startResources) {
+    vector<int> referenceLevels = startLevels;
+    vector<double> referenceResources = startResources;
+    referenceSimulateUpgradePath(settings, path, referenceLevels, referenceResources);
+    SimulationState state = makeSimulationState(settings, startLevels, startResources);
+    simulatePathFast(settings, path, state);
+    ostringstream diff;
+    for (size_t i = 0; i < referenceLevels.size() && i < state.levels.size(); ++i) {
+        if (referenceLevels[i] != state.levels[i]) {
+            diff << "level[" << i << "] reference=" << referenceLevels[i] << " fast=" << state.levels[i];
+            return diff.str();
+        }
+    }
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        if (!nearlyEqual(referenceResources[i], state.resources[i])) {
+            diff << setprecision(17) << "resource[" << i << "] reference=" << referenceResources[i]
+                 << " fast=" << state.resources[i];
+            return diff.str();
+        }
+    }
+    const double referenceScore = calculateScore(settings, referenceResources);
+    const double fastScore = calculateScore(settings, state.resources);
+    if (!nearlyEqual(referenceScore, fastScore)) {
+        diff << setprecision(17) << "score reference=" << referenceScore << " fast=" << fastScore;
+    }
+    return diff.str();
+}
+// The reference simulator always runs to the end of the event, so it is not
+// compared in timeToTarget mode.
+void sampleSelfCheck(const vector<int>& path, const SearchContext& context) {
+    if (context.settings.timeToTarget) {
+        return;
+    }
+    selfCheckSamples++;
+    const string diff = compareSimulators(context.settings, path, context.levels, context.resources);
+    if (!diff.empty() && selfCheckMismatches++ < 5) {
+        cerr << "Self-check mismatch: " << diff << "\nPath: ";
+        printVector(path, cerr);
+        cerr << "\n";
+    }
+}
+
+double evaluatePath(const vector<int>& path, const SearchContext& context){
     if (!pathRespectsSpeedCaps(path, context.levels)) {
         return -numeric_limits<double>::infinity();
     }
-    thread_local vector<double> testResources = context.resources;
-    thread_local vector<int> testLevels = context.levels;
-    testResources = context.resources;
-    testLevels = context.levels;
-    simulateUpgradePath(path, testLevels, testResources);
-    return calculateScore(testResources);
+    if (context.settings.selfCheckInterval > 0) {
+        thread_local long long evaluations = 0;
+        if (++evaluations % context.settings.selfCheckInterval == 0) {
+            sampleSelfCheck(path, context);
+        }
+    }
+    if (!context.settings.busyScenarios.empty()) {
+        return scoreRobust(context.settings, path, context.levels, context.resources);
+    }
+    SimulationState state = makeSimulationState(context.settings, context.levels, context.resources);
+    simulatePathFast(context.settings, path, state);
+    return objectiveScore(context.settings, state);
+}
+// Objective under the busy windows exactly as given; this is the score results report.
+double nominalScore(const RunSettings& settings,
+                    const vector<int>& path,
+                    const vector<int>& levels,
+                    const vector<double>& resources) {
+    SimulationState state = makeSimulationState(settings, levels, resources);
+    simulatePathFast(settings, path, state);
+    return objectiveScore(settings, state);
+}
+double scorePath(const RunSettings& settings,
+                 const vector<int>& path,
+                 const vector<int>& levels,
+                 const vector<double>& resources) {
+    if (!settings.busyScenarios.empty()) {
+        return scoreRobust(settings, path, levels, resources);
+    }
+    return nominalScore(settings, path, levels, resources);
+}
+// Keyed on the busy schedule as the simulator sees it (preprocessBusyTimes must
+// have run), so windows that overlap or touch differently never share an entry.
+CacheKey makeCacheKey(const RunSettings& settings,
+                      const vector<int>& levels,
+                      const vector<double>& resources) {
+    CacheKey key;
+    key.totalSeconds = settings.totalSeconds;
+    key.allowSpeedUpgrades = settings.allowSpeedUpgrades;
+    key.weights = {settings.EVENT_CURRENCY_WEIGHT, settings.FREE_EXP_WEIGHT,
+                   settings.PET_STONES_WEIGHT, settings.GROWTH_WEIGHT};
+    key.levels = levels;
+    key.resources = resources;
+    for (const BusySegment& segment : settings.busySchedule) {
+        key.busySegments.push_back({segment.start, segment.end, segment.windowEnd});
+    }
+    if (!settings.busyScenarios.empty()) {
+        // The samples are drawn from the run seed, so it is part of a robust key (as two exact halves).
+        key.robust = {static_cast<double>(settings.robustSamples), settings.robustJitterHours,
+                      settings.robustQuantile, static_cast<double>(settings.robustSeed),
+                      static_cast<double>(settings.seed >> 32), static_cast<double>(settings.seed & 0xffffffffULL)};
+    }
+    if (settings.timeToTarget) {
+        key.targets.assign(settings.targets.begin(), settings.targets.end());
+    }
+    return key;
 }
-void calculateFinalPath(vector<int>& path, Logger* logger = nullptr){
-    vector<int>     simulationLevels(currentLevels);
-    vector<double>  simulationResources(resourceCounts);
+void calculateFinalPath(const RunSettings& settings,
+                        vector<int>& path,
+                        const vector<int>& startLevels,
+                        const vector<double>& startResources,
+                        Logger* logger = nullptr){
+    TraceZone zone("Final path");
+    vector<int>     simulationLevels(startLevels);
+    vector<double>  simulationResources(startResources);
     bool displayUpgrades = true;
     if (logger && !logger->isConsoleEnabled()) {
         displayUpgrades = false;
@@ -525,7 +1241,7 @@ void calculateFinalPath(vector<int>& path, Logger* logger = nullptr){
             upgradeLogPtr = &upgradeLines;
         }
     }
-    simulateUpgradePath(path, simulationLevels, simulationResources, displayUpgrades, upgradeLogPtr);
+    simulateUpgradePath(settings, path, simulationLevels, simulationResources, displayUpgrades, upgradeLogPtr);
     if (logger && upgradeLogPtr) {
         for (const string& line : upgradeLines) {
             const string message = line + "\n";
@@ -536,8 +1252,8 @@ void calculateFinalPath(vector<int>& path, Logger* logger = nullptr){
             }
         }
     }
-    double simulationScore = calculateScore(simulationResources);
-    string report = formatResultsReport(path, simulationLevels, simulationResources, simulationScore);
+    double simulationScore = nominalScore(settings, path, startLevels, startResources);
+    string report = formatResultsReport(settings, path, simulationLevels, simulationResources, simulationScore);
     if (!logger) {
         cout << report;
     } else {
@@ -548,26 +1264,495 @@ void calculateFinalPath(vector<int>& path, Logger* logger = nullptr){
     }
 }
 
+// ------------ Upgrade report ------------
+// For every entry of the final path: the score change if it were left out, and
+// how long its purchase can slip before the score drops by more than
+// upgradeReportTolerance of the total. Both resume from the state before the
+// entry, and the entries are spread over a thread pool.
+constexpr double REPORT_SLACK_RESOLUTION_SECONDS = 60.0;
+
+struct UpgradeImpact {
+    int upgradeType = 0;
+    int level = 0;
+    double doneAtSeconds = 0.0;
+    double removedDelta = 0.0;
+    double slackSeconds = -1.0;   // -1 = not bought (capped or after the event ended)
+};
+// Buys path[k] from before and lets the purchase happen delaySeconds late, then
+// plays out the rest of the path and returns the final score.
+double scoreWithDelayedPurchase(const RunSettings& settings, const vector<int>& path, int k,
+                                SimulationState state, double delaySeconds) {
+    const int upgradeType = path[k];
+    const int resource = upgradeType % NUM_RESOURCES;
+    const double oldRate = state.rates[resource];
+    advanceScenarios(settings, &state, 1, upgradeType);
+    const double delay = min(delaySeconds, state.time);
+    for (int i = 0; i < NUM_RESOURCES; i++) state.resources[i] += state.rates[i] * delay;
+    state.resources[resource] -= (state.rates[resource] - oldRate) * delay;
+    state.resources[9] = min(state.resources[9], EVENT_CURRENCY_CAP);
+    state.time -= delay;
+    for (size_t j = k + 1; j < path.size(); ++j) {
+        if (advanceScenarios(settings, &state, 1, path[j]) == 0) break;
+    }
+    return objectiveScore(settings, state);
+}
+vector<UpgradeImpact> analyzeUpgradeImpacts(const RunSettings& settings,
+                                            const vector<int>& path,
+                                            const vector<int>& levels,
+                                            const vector<double>& resources) {
+    TraceZone zone("Upgrade report");
+    vector<SimulationState> before;
+    before.reserve(path.size() + 1);
+    SimulationState state = makeSimulationState(settings, levels, resources);
+    for (int upgradeType : path) {
+        before.push_back(state);
+        advanceScenarios(settings, &state, 1, upgradeType);
+    }
+    const double score = objectiveScore(settings, state);
+    const double allowedLoss = settings.upgradeReportTolerance * fabs(score);
+    const int entries = max(0, static_cast<int>(path.size()) - 1);   // the Complete marker is not reported
+    vector<UpgradeImpact> impacts(entries);
+    ThreadPool workers(max(1u, thread::hardware_concurrency()));
+    workers.runBatch(entries, [&](size_t k) {
+        UpgradeImpact& impact = impacts[k];
+        impact.upgradeType = path[k];
+        SimulationState after = before[k];
+        advanceScenarios(settings, &after, 1, path[k]);
+        impact.level = after.levels[path[k]];
+        impact.doneAtSeconds = settings.totalSeconds - after.time;
+        if (after.levels[path[k]] == before[k].levels[path[k]]) {
+            return;   // a capped speed upgrade, or the event was already over
+        }
+        SimulationState skipped = before[k];
+        for (size_t j = k + 1; j < path.size(); ++j) {
+            if (advanceScenarios(settings, &skipped, 1, path[j]) == 0) break;
+        }
+        impact.removedDelta = objectiveScore(settings, skipped) - score;
+        double lo = 0.0, hi = after.time;
+        if (score - scoreWithDelayedPurchase(settings, path, static_cast<int>(k), before[k], hi) <= allowedLoss) {
+            impact.slackSeconds = hi;
+            return;
+        }
+        while (hi - lo > REPORT_SLACK_RESOLUTION_SECONDS) {
+            const double mid = 0.5 * (lo + hi);
+            if (score - scoreWithDelayedPurchase(settings, path, static_cast<int>(k), before[k], mid) <= allowedLoss) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        impact.slackSeconds = lo;
+    });
+    return impacts;
+}
+string formatUpgradeReport(const RunSettings& settings,
+                           const vector<int>& path,
+                           const vector<int>& levels,
+                           const vector<double>& resources) {
+    const vector<UpgradeImpact> impacts = analyzeUpgradeImpacts(settings, path, levels, resources);
+    auto duration = [](double seconds) {
+        const int total = static_cast<int>(seconds);
+        ostringstream out;
+        out << total / 86400 << "d " << setw(2) << setfill('0') << (total / 3600) % 24
+            << ":" << setw(2) << setfill('0') << (total / 60) % 60;
+        return out.str();
+    };
+    ostringstream out;
+    out << "Upgrade report (score change if left out; how late the purchase can be before it costs more than "
+        << settings.upgradeReportTolerance * 100.0 << "% of the score):\n";
+    for (size_t k = 0; k < impacts.size(); ++k) {
+        const UpgradeImpact& impact = impacts[k];
+        out << "  " << setw(4) << k + 1 << "  " << left << setw(22)
+            << (upgradeNames[impact.upgradeType] + " " + to_string(impact.level)) << right
+            << "  done " << duration(impact.doneAtSeconds);
+        if (impact.slackSeconds < 0) {
+            out << "  not bought\n";
+            continue;
+        }
+        out << "  removed " << showpos << setprecision(6) << impact.removedDelta << noshowpos
+            << "  slack " << duration(impact.slackSeconds) << "\n";
+    }
+    return out.str();
+}
+
+// ------------ Candidate evaluation ------------
+// Candidates are resumed from the checkpoint where they first differ from the
+// incumbent path and, with useScoreBound, dropped as soon as an optimistic bound
+// on their final score cannot beat it. With screeningTolerance, a candidate is
+// also compared with the incumbent a few steps after the two paths line up
+// again: if its coasting score trails the incumbent's at the same point by more
+// than the tolerance, it is dropped without simulating the rest. Unlike the
+// bound this can drop a winner, so every SCREEN_AUDIT_INTERVAL-th screened
+// candidate is simulated to the end to measure how often that happens.
+constexpr int BOUND_CHECK_STRIDE = 8;          // upgrade steps between bound checks
+constexpr double BOUND_RELATIVE_SLACK = 1e-9;  // absorbs rounding differences from the step-by-step simulation
+constexpr int SCREEN_HORIZON_STEPS = 16;       // steps simulated past the realignment point before screening
+constexpr long long SCREEN_AUDIT_INTERVAL = 64;
+
+// Final score if every upgrade still in remaining were bought right now for free
+// and production ran at those levels until the end of the event. In timeToTarget
+// mode the same free production gives the earliest the targets could be met, so
+// a candidate is dropped once it can no longer beat the incumbent's time.
+double scoreUpperBound(const RunSettings& settings, const SimulationState& state, const UpgradeCounts& remaining) {
+    array<double, NUM_RESOURCES> bestRates;
+    for (int i = 0; i < NUM_RESOURCES; i++) {
+        const int level = state.levels[i] + remaining[i];
+        const int speedLevel = min(SPEED_LEVEL_CAP, state.levels[i + NUM_RESOURCES] + remaining[i + NUM_RESOURCES]);
+        bestRates[i] = level * CYCLE_TIME_MULTIPLIERS[i] * SPEED_MULTIPLIERS[speedLevel];
+    }
+    double bound;
+    if (settings.timeToTarget) {
+        SimulationState best = state;
+        best.rates = bestRates;
+        for (int t = 0; t < NUM_RESOURCES * 2; t++) {
+            best.levels[t] = t < NUM_RESOURCES ? state.levels[t] + remaining[t]
+                                               : min(SPEED_LEVEL_CAP, state.levels[t] + remaining[t]);
+        }
+        bound = timeToTargetScore(settings, best);
+    } else {
+        array<double, NUM_RESOURCES> best;
+        for (int i = 0; i < NUM_RESOURCES; i++) best[i] = state.resources[i] + bestRates[i] * state.time;
+        best[9] = min(best[9], EVENT_CURRENCY_CAP);
+        bound = calculateScore(settings, best);
+    }
+    return bound + fabs(bound) * BOUND_RELATIVE_SLACK;
+}
+// Cheap stand-in for the final score: current resources plus production at the
+// current levels until the end, with no further upgrades.
+double coastScore(const RunSettings& settings, const SimulationState& state) {
+    if (settings.timeToTarget) {
+        return timeToTargetScore(settings, state);   // already coasts at the current rates
+    }
+    array<double, NUM_RESOURCES> coast;
+    for (int i = 0; i < NUM_RESOURCES; i++) coast[i] = state.resources[i] + state.rates[i] * state.time;
+    coast[9] = min(coast[9], EVENT_CURRENCY_CAP);
+    return calculateScore(settings, coast);
+}
+void rebuildCheckpoints(OptimizationPackage& package, const SearchContext& context) {
+    const vector<int>& path = package.path;
+    package.checkpointPath = path;
+    package.checkpoints.clear();
+    package.suffixCounts.assign(path.size() + 1, UpgradeCounts{});
+    for (int k = static_cast<int>(path.size()) - 1; k >= 0; k--) {
+        package.suffixCounts[k] = package.suffixCounts[k + 1];
+        if (path[k] >= 0 && path[k] <= NUM_RESOURCES * 2) package.suffixCounts[k][path[k]]++;
+    }
+    if (!pathRespectsSpeedCaps(path, context.levels)) {
+        return;   // no checkpoints: candidates fall back to full evaluation
+    }
+    thread_local vector<SimulationState> states;
+    makeScenarioStates(context.settings, context.levels, context.resources, states);
+    const int count = static_cast<int>(states.size());
+    package.checkpoints.reserve((path.size() + 1) * count);
+    for (int upgradeType : path) {
+        package.checkpoints.insert(package.checkpoints.end(), states.begin(), states.end());
+        advanceScenarios(context.settings, states.data(), count, upgradeType);
+    }
+    package.checkpoints.insert(package.checkpoints.end(), states.begin(), states.end());
+}
+// An entry bought the instant the previous one finished (no wait, no busy delay)
+// only spends resources that were already there. Any order of a run of such
+// entries is affordable throughout and leaves the same levels and the same
+// resources at the same time, so swaps and rotations inside a run cannot change
+// the score beyond rounding. The entry that waited before the run is not part of
+// it: moving a cheaper entry ahead of it could start earlier. The event currency
+// cap cannot break this: no time passes inside a run, so the currency only drops
+// by costs and the clamp after each purchase never applies.
+void markCommutingRuns(OptimizationPackage& package, const SearchContext& context) {
+    const int count = scenarioCount(context.settings);
+    const int entries = static_cast<int>(package.path.size());
+    package.commutingRun.assign(entries, -1);
+    if (package.checkpoints.empty()) {
+        return;
+    }
+    auto instant = [&](int k) {
+        if (package.path[k] == NUM_RESOURCES * 2) return false;
+        for (int s = 0; s < count; s++) {
+            const SimulationState& before = package.checkpoints[static_cast<size_t>(k) * count + s];
+            const SimulationState& after = package.checkpoints[static_cast<size_t>(k + 1) * count + s];
+            if (before.time != after.time) return false;
+        }
+        return true;
+    };
+    for (int start = 0; start < entries;) {
+        int end = start;
+        while (end < entries && instant(end)) end++;
+        if (end - start >= 2) {
+            fill(package.commutingRun.begin() + start, package.commutingRun.begin() + end, start);
+        }
+        start = max(end, start + 1);
+    }
+}
+bool inCommutingRun(const OptimizationPackage& package, int first, int last) {
+    return !package.commutingRun.empty() && package.commutingRun[first] >= 0
+        && package.commutingRun[first] == package.commutingRun[last];
+}
+// Marks the don't-look bits stale so the next sweep rebuilds them; for reorders made outside a move.
+void invalidateDontLookBits(OptimizationPackage& package) {
+    package.dontLookSwap.clear();
+    package.dontLookRotate.clear();
+    package.completionTimes.clear();
+}
+// Rebuilds the checkpoints after the path changed. With symmetry reduction each
+// commuting run is also sorted by upgrade type, so equivalent paths share one order;
+// after such a sort the package score is re-evaluated for the new order.
+void ensureCheckpoints(OptimizationPackage& package, const SearchContext& context) {
+    if (package.checkpointPath == package.path) {
+        return;
+    }
+    rebuildCheckpoints(package, context);
+    if (!context.settings.useSymmetryReduction) {
+        package.commutingRun.clear();
+        return;
+    }
+    markCommutingRuns(package, context);
+    bool reordered = false;
+    for (size_t start = 0; start < package.commutingRun.size();) {
+        size_t end = start + 1;
+        if (package.commutingRun[start] == static_cast<int>(start)) {
+            while (end < package.commutingRun.size() && package.commutingRun[end] == static_cast<int>(start)) end++;
+            const auto first = package.path.begin() + start, last = package.path.begin() + end;
+            if (!is_sorted(first, last)) {
+                sort(first, last);
+                reordered = true;
+            }
+        }
+        start = end;
+    }
+    if (reordered) {
+        rebuildCheckpoints(package, context);
+        markCommutingRuns(package, context);
+        invalidateDontLookBits(package);   // the bits and completion times belonged to the old order
+        // Equal up to rounding, but the incumbent score must describe the path actually held.
+        package.score = evaluatePath(package.path, context);
+    }
+}
+// Scores package.path with edit applied, resuming from the checkpoint where the
+// two first differ. The bound and the screen drop candidates against cutoff;
+// pass -infinity to get every feasible candidate's exact score.
+double resumeEdit(const PathEdit& edit, const OptimizationPackage& package, const SearchContext& context,
+                  double cutoff, BoundStats& stats) {
+    const RunSettings& settings = context.settings;
+    const vector<int>& base = package.path;
+    stats.candidates++;
+    const int divergeAt = edit.divergeAt();
+    UpgradeCounts remaining = package.suffixCounts[divergeAt];
+    if (edit.kind == PathEdit::Insert) remaining[edit.upgrade]++;
+    if (edit.kind == PathEdit::Remove) remaining[base[edit.a]]--;
+    // Speed caps depend only on how many of each upgrade the path holds.
+    const UpgradeCounts& total = package.suffixCounts[0];
+    for (int t = NUM_RESOURCES; t < NUM_RESOURCES * 2; t++) {
+        if (context.levels[t] + total[t] - package.suffixCounts[divergeAt][t] + remaining[t] > SPEED_LEVEL_CAP) {
+            return -numeric_limits<double>::infinity();
+        }
+    }
+    thread_local vector<SimulationState> states;
+    thread_local vector<double> values;
+    const int count = scenarioCount(settings);
+    const auto row = package.checkpoints.begin() + static_cast<ptrdiff_t>(divergeAt) * count;
+    states.assign(row, row + count);
+    values.resize(count);
+    stats.stepsReused += divergeAt;
+    const bool useBound = settings.useScoreBound;
+    const int pathLength = edit.length(static_cast<int>(base.size()));
+    const int screenAt = settings.screeningTolerance > 0 ? edit.realignAt() + SCREEN_HORIZON_STEPS : pathLength;
+    bool auditing = false;
+    for (int k = divergeAt; k < pathLength; k++) {
+        if (k == screenAt && k + edit.baseOffset() < static_cast<int>(base.size())) {
+            const auto incumbent = package.checkpoints.begin() + static_cast<ptrdiff_t>(k + edit.baseOffset()) * count;
+            for (int s = 0; s < count; s++) values[s] = coastScore(settings, incumbent[s]);
+            const double incumbentCoast = aggregateScenarios(settings, values);
+            for (int s = 0; s < count; s++) values[s] = coastScore(settings, states[s]);
+            if (aggregateScenarios(settings, values) < incumbentCoast - settings.screeningTolerance * fabs(cutoff)) {
+                stats.screened++;
+                if (stats.screened % SCREEN_AUDIT_INTERVAL != 0) {
+                    stats.stepsScreened += pathLength - k;
+                    return -numeric_limits<double>::infinity();
+                }
+                stats.screenAudits++;
+                auditing = true;
+            }
+        }
+        if (useBound && (k - divergeAt) % BOUND_CHECK_STRIDE == 0) {
+            for (int s = 0; s < count; s++) values[s] = scoreUpperBound(settings, states[s], remaining);
+            if (aggregateScenarios(settings, values) < cutoff) {
+                if (!auditing) stats.pruned++;
+                stats.stepsPruned += pathLength - k;
+                return -numeric_limits<double>::infinity();
+            }
+        }
+        const int upgradeType = edit.upgradeAt(base, k);
+        remaining[upgradeType]--;
+        stats.stepsSimulated++;
+        if (advanceScenarios(settings, states.data(), count, upgradeType) == 0) break;
+    }
+    for (int s = 0; s < count; s++) values[s] = objectiveScore(settings, states[s]);
+    const double score = aggregateScenarios(settings, values);
+    if (auditing) {
+        // The screen's verdict stands; the audit only counts what it cost.
+        if (score > cutoff) stats.screenFalseRejects++;
+        return -numeric_limits<double>::infinity();
+    }
+    return score;
+}
+// Scores package.path with edit applied, without building the edited path.
+// Returns -infinity for infeasible candidates and for candidates the bound shows
+// cannot reach package.score. ensureCheckpoints must have run for the current path.
+double evaluateEdit(const PathEdit& edit, OptimizationPackage& package, const SearchContext& context) {
+    thread_local vector<int> candidate;
+    if (package.checkpoints.empty()) {
+        edit.materialize(package.path, candidate);
+        return evaluatePath(candidate, context);
+    }
+    const long long screenedBefore = package.boundStats.screened;
+    const double score = resumeEdit(edit, package, context, package.score, package.boundStats);
+    // Screened candidates may be winners by design; the audit counts those instead.
+    if (context.settings.selfCheckInterval > 0 && package.boundStats.screened == screenedBefore) {
+        thread_local long long evaluations = 0;
+        if (++evaluations % context.settings.selfCheckInterval == 0) {
+            selfCheckSamples++;
+            edit.materialize(package.path, candidate);
+            const double fullScore = scorePath(context.settings, candidate, context.levels, context.resources);
+            const bool rejected = score == -numeric_limits<double>::infinity();
+            bool consistent;
+            if (!pathRespectsSpeedCaps(candidate, context.levels)) {
+                consistent = rejected;
+            } else if (rejected) {
+                consistent = fullScore < package.score || nearlyEqual(fullScore, package.score);
+            } else {
+                consistent = nearlyEqual(score, fullScore);
+            }
+            if (!consistent && selfCheckMismatches++ < 5) {
+                cerr << setprecision(17) << "Self-check mismatch: resumed candidate scored " << score
+                     << ", full simulation " << fullScore << " (incumbent " << package.score << ")\nPath: ";
+                printVector(candidate, cerr);
+                cerr << "\n";
+            }
+        }
+    }
+    return score;
+}
+string formatBoundStats(const BoundStats& stats) {
+    const long long totalSteps = stats.stepsSimulated + stats.stepsReused + stats.stepsPruned + stats.stepsScreened;
+    auto percent = [](long long part, long long whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+    ostringstream out;
+    out << fixed << setprecision(1)
+        << "Score bound: " << stats.pruned << " of " << stats.candidates << " candidates pruned ("
+        << percent(stats.pruned, stats.candidates) << "%); simulated " << stats.stepsSimulated << " of "
+        << totalSteps << " path steps (" << percent(stats.stepsReused, totalSteps) << "% reused from checkpoints, "
+        << percent(stats.stepsPruned, totalSteps) << "% skipped by the bound";
+    if (stats.stepsScreened > 0) out << ", " << percent(stats.stepsScreened, totalSteps) << "% by the screen";
+    out << ").\n";
+    return out.str();
+}
+string formatScreeningStats(const BoundStats& stats) {
+    ostringstream out;
+    out << fixed << setprecision(1)
+        << "Screening: " << stats.screened << " of " << stats.candidates << " candidates screened out ("
+        << (stats.candidates > 0 ? 100.0 * stats.screened / stats.candidates : 0.0) << "%); "
+        << stats.screenFalseRejects << " of " << stats.screenAudits << " audited would have improved the best ("
+        << (stats.screenAudits > 0 ? 100.0 * stats.screenFalseRejects / stats.screenAudits : 0.0)
+        << "% false rejects).\n";
+    return out.str();
+}
+
+// ------------ Don't-look bits ------------
+vector<double> simulateCompletionTimes(const vector<int>& path, const SearchContext& context) {
+    SimulationState state = makeSimulationState(context.settings, context.levels, context.resources);
+    vector<double> times;
+    times.reserve(path.size());
+    const int totalSeconds = context.settings.totalSeconds;
+    for (int upgradeType : path) {
+        const bool cappedSpeed = upgradeType >= NUM_RESOURCES && state.levels[upgradeType] >= SPEED_LEVEL_CAP;
+        if (state.time >= 1e-3 && !cappedSpeed) {
+            advanceUpgrade(context.settings, state, upgradeType);
+        }
+        times.push_back(totalSeconds - state.time);
+    }
+    return times;
+}
+void resetDontLookBits(OptimizationPackage& package, const SearchContext& context) {
+    package.dontLookSwap.assign(package.path.size(), 0);
+    package.dontLookRotate.assign(package.path.size(), 0);
+    package.completionTimes = simulateCompletionTimes(package.path, context);
+}
+bool dontLookBitsStale(const OptimizationPackage& package) {
+    return package.dontLookSwap.size() != package.path.size()
+        || package.dontLookRotate.size() != package.path.size()
+        || package.completionTimes.size() != package.path.size();
+}
+// Realigns the bits with the accepted move, then wakes positions near the change
+// and every position whose completion time moved by more than the shift threshold.
+void wakeAfterAcceptedMove(OptimizationPackage& package, const SearchContext& context, const Proposal& proposal) {
+    if (!context.settings.useDontLookBits) {
+        return;
+    }
+    vector<double>& oldTimes = package.completionTimes;
+    for (vector<char>* bits : {&package.dontLookSwap, &package.dontLookRotate}) {
+        if (proposal.type == "Insert" && proposal.indexA <= static_cast<int>(bits->size())) {
+            bits->insert(bits->begin() + proposal.indexA, 0);
+        } else if (proposal.type == "Remove" && proposal.indexA < static_cast<int>(bits->size())) {
+            bits->erase(bits->begin() + proposal.indexA);
+        }
+    }
+    if (proposal.type == "Insert" && proposal.indexA <= static_cast<int>(oldTimes.size())) {
+        const double previousTime = proposal.indexA > 0 ? oldTimes[proposal.indexA - 1] : 0.0;
+        oldTimes.insert(oldTimes.begin() + proposal.indexA, previousTime);
+    } else if (proposal.type == "Remove" && proposal.indexA < static_cast<int>(oldTimes.size())) {
+        oldTimes.erase(oldTimes.begin() + proposal.indexA);
+    }
+    if (dontLookBitsStale(package)) {
+        resetDontLookBits(package, context);
+        return;
+    }
+    const int lastIndex = static_cast<int>(package.path.size()) - 1;
+    auto wake = [&](int k) {
+        package.dontLookSwap[k] = 0;
+        package.dontLookRotate[k] = 0;
+    };
+    auto wakeRange = [&](int lo, int hi) {
+        for (int k = max(0, lo - DONT_LOOK_RADIUS); k <= min(lastIndex, hi + DONT_LOOK_RADIUS); k++) {
+            wake(k);
+        }
+    };
+    if (proposal.type == "Swap") {
+        wakeRange(proposal.indexA, proposal.indexA);
+        wakeRange(proposal.indexB, proposal.indexB);
+    } else if (proposal.type == "Rotate") {
+        wakeRange(proposal.indexA, proposal.indexB - 1);
+    } else {
+        wakeRange(proposal.indexA, proposal.indexA);
+    }
+    vector<double> newTimes = simulateCompletionTimes(package.path, context);
+    for (int k = 0; k <= lastIndex; k++) {
+        if (fabs(newTimes[k] - oldTimes[k]) > DONT_LOOK_TIME_SHIFT_SECONDS) {
+            wake(k);
+        }
+    }
+    oldTimes.swap(newTimes);
+}
+
 // ------------ Moves ------------
 bool tryInsertUpgrade(OptimizationPackage& package, SearchContext& context, Proposal* outProposal = nullptr) {
+    TraceZone zone("Insert");
+    ensureCheckpoints(package, context);
     int pathLength = (int)package.path.size();
-    thread_local vector<int> candidatePath;
-    uniform_int_distribution<> positionDist(0, pathLength);
-    int startPosition = positionDist(package.randomEngine);
+    int startPosition = package.randomEngine.uniformInt(0, pathLength);
+    const bool allowSpeedUpgrades = context.settings.allowSpeedUpgrades;
     const int maxTypes = (allowSpeedUpgrades ? NUM_RESOURCES * 2 : NUM_RESOURCES);
     for (int i = 0; i < pathLength; i++) {
-        candidatePath = package.path;
         int modulatedInsertPosition = (i + startPosition) % pathLength;
-        candidatePath.insert(candidatePath.begin() + modulatedInsertPosition, 0);
         int startingUpgradeType = package.randomEngine() % (allowSpeedUpgrades ? NUM_RESOURCES * 2 : NUM_RESOURCES);
         for (int upgradeType = 0; upgradeType < maxTypes; upgradeType++) {
             int modulatedUpgradeType = (upgradeType + startingUpgradeType) % maxTypes;
-            candidatePath[modulatedInsertPosition] = modulatedUpgradeType;
-            double testScore = evaluatePath(candidatePath, context);
+            const PathEdit edit = PathEdit::insertAt(modulatedInsertPosition, modulatedUpgradeType);
+            double testScore = evaluateEdit(edit, package, context);
             if (testScore > package.score) {
-                if (outProposal) *outProposal = Proposal::Insert(modulatedInsertPosition, modulatedUpgradeType, testScore);
-                package.path.insert(package.path.begin() + modulatedInsertPosition, modulatedUpgradeType);
+                const Proposal proposal = Proposal::Insert(modulatedInsertPosition, modulatedUpgradeType, testScore);
+                if (outProposal) *outProposal = proposal;
+                edit.apply(package.path);
                 package.score = testScore;
+                wakeAfterAcceptedMove(package, context, proposal);
                 context.logger.logImprovement("Insert", package.path, package.score);
                 return true;
             }
@@ -577,20 +1762,25 @@ bool tryInsertUpgrade(OptimizationPackage& package, SearchContext& context, Prop
     return false;
 }
 bool tryRemoveUpgrade(OptimizationPackage& package, SearchContext& context, Proposal* outProposal = nullptr) {
+    TraceZone zone("Remove");
+    ensureCheckpoints(package, context);
     int pathLength = (int)package.path.size() - 1;
-    thread_local vector<int> candidatePath;
-    uniform_int_distribution<> swapDist(0, pathLength - 2);
-    int startPos = swapDist(package.randomEngine);
+    if (pathLength < 2) {   // timeToTarget can trim a path down to a few entries
+        package.deadMoves.insert("Remove");
+        return false;
+    }
+    int startPos = package.randomEngine.uniformInt(0, pathLength - 2);
     for (int i = 0; i < pathLength; i++) {
         int removePos = (i + startPos) % (pathLength);
-        if (!allowSpeedUpgrades && package.path[removePos] >= NUM_RESOURCES) continue;
-        candidatePath = package.path;
-        candidatePath.erase(candidatePath.begin() + removePos);
-        double testScore = evaluatePath(candidatePath, context);
+        if (!context.settings.allowSpeedUpgrades && package.path[removePos] >= NUM_RESOURCES) continue;
+        const PathEdit edit = PathEdit::removeAt(removePos);
+        double testScore = evaluateEdit(edit, package, context);
         if (testScore >= package.score) {
-            if (outProposal) *outProposal = Proposal::Remove(removePos, testScore);
+            const Proposal proposal = Proposal::Remove(removePos, testScore);
+            if (outProposal) *outProposal = proposal;
             package.score = testScore;
-            package.path = candidatePath;
+            edit.apply(package.path);
+            wakeAfterAcceptedMove(package, context, proposal);
             context.logger.logImprovement("Remove", package.path, package.score);
             return true;
         }
@@ -599,52 +1789,78 @@ bool tryRemoveUpgrade(OptimizationPackage& package, SearchContext& context, Prop
     return false;
 }
 bool trySwapUpgrades(OptimizationPackage& package, SearchContext& context, Proposal* outProposal = nullptr) {
+    TraceZone zone("Swap");
+    ensureCheckpoints(package, context);
     int pathLength = (int)package.path.size() - 1;
-    thread_local vector<int> candidatePath;
-    candidatePath = package.path;
+    if (pathLength < 3) {
+        package.deadMoves.insert("Swap");
+        return false;
+    }
+    thread_local vector<char> rowScanned;
+    const bool useDontLookBits = context.settings.useDontLookBits;
+    if (useDontLookBits && dontLookBitsStale(package)) {
+        resetDontLookBits(package, context);
+    }
+    rowScanned.assign(package.path.size(), 0);
     double testScore;
-    uniform_int_distribution<> swapDist(0, pathLength - 2);
-    int startPos = swapDist(package.randomEngine);
+    int startPos = package.randomEngine.uniformInt(0, pathLength - 2);
     for (int i2 = 0; i2 < pathLength - 1; i2++) {
-        for (int j2 = i2 + 1; j2 < pathLength - 1; j2++) {
-            int i = (i2 + startPos) % (pathLength - 1);
+        int i = (i2 + startPos) % (pathLength - 1);
+        if (useDontLookBits && package.dontLookSwap[i]) continue;
+        // With don't-look bits a row also pairs with earlier positions whose own row was skipped.
+        for (int j2 = useDontLookBits ? 0 : i2 + 1; j2 < pathLength - 1; j2++) {
+            if (j2 == i2) continue;
             int j = (j2 + startPos) % (pathLength - 1);
-            if (candidatePath[i] == candidatePath[j]) continue;
-            swap(candidatePath[i], candidatePath[j]);
-            testScore = evaluatePath(candidatePath, context);
+            if (j2 < i2 && rowScanned[j]) continue;
+            if (package.path[i] == package.path[j]) continue;
+            if (inCommutingRun(package, i, j)) {
+                package.boundStats.commuting++;
+                continue;
+            }
+            const PathEdit edit = PathEdit::swapAt(i, j);
+            testScore = evaluateEdit(edit, package, context);
             if (testScore > package.score) {
-                if (outProposal) *outProposal = Proposal::Swap(i, j, testScore);
-                package.path = candidatePath;
+                const Proposal proposal = Proposal::Swap(min(i, j), max(i, j), testScore);
+                if (outProposal) *outProposal = proposal;
+                edit.apply(package.path);
                 package.score = testScore;
+                wakeAfterAcceptedMove(package, context, proposal);
                 context.logger.logImprovement("Swap", package.path, package.score);
                 return true;
             }
-            swap(candidatePath[i], candidatePath[j]);
         }
+        rowScanned[i] = 1;
+        if (useDontLookBits) package.dontLookSwap[i] = 1;
     }
     package.deadMoves.insert("Swap");
     return false;
 }
 bool tryRotateSubsequences(OptimizationPackage& package, SearchContext& context, Proposal* outProposal = nullptr) {
+    TraceZone zone("Rotate");
+    ensureCheckpoints(package, context);
     int pathLength = (int)package.path.size() - 1;
-    thread_local vector<int> candidatePath;
+    if (pathLength < 3) {
+        return false;
+    }
     double testScore;
-    uniform_int_distribution<> rotateDist(0, pathLength - 3);
-    int i = rotateDist(package.randomEngine);
-    uniform_int_distribution<> rotateDist2(i+2, pathLength - 1);
-    int j = rotateDist2(package.randomEngine);
+    int i = package.randomEngine.uniformInt(0, pathLength - 3);
+    int j = package.randomEngine.uniformInt(i + 2, pathLength - 1);
     for (int k = 0; k < j-i; k++) {
-        candidatePath = package.path;
         int offset = (k + 2) / 2;
         bool isLeft = (k % 2 == 0);
-        if(isLeft)  rotate(candidatePath.begin() + i, candidatePath.begin() + i + offset, candidatePath.begin() + j + 1);
-        else        rotate(candidatePath.begin() + i, candidatePath.begin() + j - offset + 1, candidatePath.begin() + j + 1);
-        testScore = evaluatePath(candidatePath, context);
         int rotationPos = isLeft ? i + offset: j - offset + 1;
+        if (inCommutingRun(package, i, j)) {
+            package.boundStats.commuting++;
+            continue;
+        }
+        const PathEdit edit = PathEdit::rotateRange(i, rotationPos, j + 1);
+        testScore = evaluateEdit(edit, package, context);
         if (testScore > package.score) {
-            if (outProposal) *outProposal = Proposal::Rotate(i, j + 1, rotationPos, testScore);
-            package.path = candidatePath;
+            const Proposal proposal = Proposal::Rotate(i, j + 1, rotationPos, testScore);
+            if (outProposal) *outProposal = proposal;
+            edit.apply(package.path);
             package.score = testScore;
+            wakeAfterAcceptedMove(package, context, proposal);
             context.logger.logImprovement("Rotation", package.path, package.score);
             return true;
         }
@@ -652,54 +1868,72 @@ bool tryRotateSubsequences(OptimizationPackage& package, SearchContext& context,
     return false;
 }
 bool exhaustRotateSubsequences(OptimizationPackage& package, SearchContext& context, Proposal* outProposal = nullptr) {
+    TraceZone zone("Rotate sweep");
+    ensureCheckpoints(package, context);
     int pathLength = (int)package.path.size() - 1;
+    if (pathLength < 3) {
+        package.deadMoves.insert("Rotate");
+        return false;
+    }
     int maxIndex = pathLength - 1;
-    thread_local vector<int> candidatePath;
     double testScore = package.score;
-    uniform_int_distribution<> rotateDist(0, maxIndex - 2);
-    int i = rotateDist(package.randomEngine);
+    const bool useDontLookBits = context.settings.useDontLookBits;
+    if (useDontLookBits && dontLookBitsStale(package)) {
+        resetDontLookBits(package, context);
+    }
+    int i = package.randomEngine.uniformInt(0, maxIndex - 2);
     for (int i2 = 0; i2 < maxIndex - 1; i2++){
         int i3 = (i + i2) % (maxIndex - 1);
-        uniform_int_distribution<> rotateDist2(0, maxIndex-i3);
-        int j = rotateDist2(package.randomEngine);
+        if (useDontLookBits && package.dontLookRotate[i3]) continue;
+        int j = package.randomEngine.uniformInt(0, maxIndex - i3);
         for (int j2 = 0; j2 < maxIndex - i3 - 1; j2++){
             int j3 = i3 + 2 + ((j + j2) % (maxIndex - i3 - 1));
+            if (inCommutingRun(package, i3, j3)) {
+                package.boundStats.commuting += j3 - i3;
+                continue;
+            }
             for (int k = 0; k < j3-i3; k++) {
-                candidatePath = package.path;
                 int offset = (k + 2) / 2;
                 bool isLeft = (k % 2 == 0);
-                if(isLeft)  rotate(candidatePath.begin() + i3, candidatePath.begin() + i3 + offset, candidatePath.begin() + j3 + 1);
-                else        rotate(candidatePath.begin() + i3, candidatePath.begin() + j3 - offset + 1, candidatePath.begin() + j3 + 1);
-                testScore = evaluatePath(candidatePath, context);
                 int rotationPos = isLeft ? i3 + offset: j3 - offset + 1;
+                const PathEdit edit = PathEdit::rotateRange(i3, rotationPos, j3 + 1);
+                testScore = evaluateEdit(edit, package, context);
                 if (testScore > package.score) {
-                    if (outProposal) *outProposal = Proposal::Rotate(i3, j3+1, rotationPos, testScore);
-                    package.path = candidatePath;
+                    const Proposal proposal = Proposal::Rotate(i3, j3+1, rotationPos, testScore);
+                    if (outProposal) *outProposal = proposal;
+                    edit.apply(package.path);
                     package.score = testScore;
+                    wakeAfterAcceptedMove(package, context, proposal);
                     context.logger.logImprovement("Rotation", package.path, package.score);
                     return true;
                 }
             }
         }
+        if (useDontLookBits) package.dontLookRotate[i3] = 1;
     }
     package.deadMoves.insert("Rotate");
     return false;
 }
 void optimizeUpgradePath(OptimizationPackage& package, SearchContext& context, const int maxIterations = 10000) {
-    random_device seed;
-    mt19937 randomEngine(seed());
+    TraceZone zone("Local search");
     int iterationCount = 0;
     int noImprovementStreak = 0;
     package.score = evaluatePath(package.path, context);
+    if (context.settings.useDontLookBits) {
+        resetDontLookBits(package, context);
+    }
     while (noImprovementStreak < maxIterations) {
+        if (context.cancelled && context.cancelled->load()) {
+            break;
+        }
         iterationCount++;
         bool improved = false;
         int strategy = iterationCount % 100;
-        if(package.deadMoves.count("Rotation")){
-            break;
+        if(package.deadMoves.count("Rotate")){
+            break;   // the full rotation sweep found nothing either: local optimum
         }
         else if (package.deadMoves.count("Insert") && package.deadMoves.count("Remove") && package.deadMoves.count("Swap")) {
-            improved = tryRotateSubsequences(package, context);
+            improved = exhaustRotateSubsequences(package, context);
         }
         else if (strategy < 15 && !package.deadMoves.count("Insert")) {
             improved = tryInsertUpgrade(package, context);
@@ -723,34 +1957,1026 @@ void optimizeUpgradePath(OptimizationPackage& package, SearchContext& context, c
     }
 }
 
+// =================== MEMETIC SEARCH ====================================
+// Keeps a population of locally optimised paths, recombines them and polishes
+// each child with a short optimizeUpgradePath run on the worker pool.
+struct Individual {
+    vector<int> path;
+    double score;
+};
+
+// The child keeps parent a's multiset of upgrades: a's first cut entries, then
+// the rest in the order they appear in b, then whatever b lacks in a's order.
+// Speed caps only depend on the multiset, so a valid a gives a valid child. The
+// "Complete" marker stays last.
+vector<int> orderCrossover(const vector<int>& a, const vector<int>& b, int cut) {
+    constexpr int COMPLETE = NUM_RESOURCES * 2;
+    UpgradeCounts left{};
+    bool hasComplete = false;
+    for (int upgrade : a) {
+        if (upgrade == COMPLETE) hasComplete = true;
+        else if (upgrade >= 0 && upgrade < COMPLETE) left[upgrade]++;
+    }
+    vector<int> child;
+    child.reserve(a.size());
+    auto take = [&](int upgrade) {
+        if (upgrade >= 0 && upgrade < COMPLETE && left[upgrade] > 0) {
+            child.push_back(upgrade);
+            left[upgrade]--;
+        }
+    };
+    for (int k = 0; k < cut && k < static_cast<int>(a.size()); k++) take(a[k]);
+    for (int upgrade : b) take(upgrade);
+    for (int k = cut; k < static_cast<int>(a.size()); k++) take(a[k]);
+    if (hasComplete) child.push_back(COMPLETE);
+    return child;
+}
+void runMemeticSearch(OptimizationPackage& package, SearchContext& context) {
+    TraceZone zone("Memetic search");
+    const RunSettings& settings = context.settings;
+    const int populationSize = settings.memeticPopulation;
+    ThreadPool workers(searchThreads(context));
+    CounterRng rng(package.randomEngine());
+    auto cancelled = [&] { return context.cancelled && context.cancelled->load(); };
+
+    // Polishes every start in parallel; each worker gets its own quiet logger and engine.
+    vector<OptimizationPackage> polished;
+    auto polishAll = [&](vector<vector<int>>& starts) {
+        vector<uint64_t> seeds(starts.size());
+        for (auto& seed : seeds) seed = rng();
+        polished.assign(starts.size(), OptimizationPackage{});
+        TraceZone batch("Polish batch");
+        workers.runBatch(starts.size(), [&](size_t i) {
+            TraceZone task("Polish");
+            Logger quiet(1, false, string(), false);
+            SearchContext local{quiet, context.resources, context.levels, settings, context.cancelled};
+            OptimizationPackage child = {move(starts[i]), 0, CounterRng(seeds[i])};
+            optimizeUpgradePath(child, local, settings.memeticPolishIterations);
+            polished[i] = move(child);
+        });
+        for (const OptimizationPackage& child : polished) {
+            BoundStats& total = package.boundStats;
+            total.candidates += child.boundStats.candidates;
+            total.pruned += child.boundStats.pruned;
+            total.stepsSimulated += child.boundStats.stepsSimulated;
+            total.stepsReused += child.boundStats.stepsReused;
+            total.stepsPruned += child.boundStats.stepsPruned;
+            total.screened += child.boundStats.screened;
+            total.stepsScreened += child.boundStats.stepsScreened;
+            total.screenAudits += child.boundStats.screenAudits;
+            total.screenFalseRejects += child.boundStats.screenFalseRejects;
+            total.commuting += child.boundStats.commuting;
+        }
+    };
+    // Best first, identical paths dropped.
+    auto survivors = [&](vector<Individual>& pool) {
+        sort(pool.begin(), pool.end(), [](const Individual& x, const Individual& y) { return x.score > y.score; });
+        vector<Individual> kept;
+        for (Individual& candidate : pool) {
+            if (static_cast<int>(kept.size()) == populationSize) break;
+            bool duplicate = false;
+            for (const Individual& member : kept) {
+                if (member.score == candidate.score && member.path == candidate.path) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) kept.push_back(move(candidate));
+        }
+        pool.swap(kept);
+    };
+
+    // Initial population: the seed, shuffled variants of it and random paths.
+    vector<vector<int>> starts;
+    starts.push_back(package.path);
+    for (int i = 1; i < populationSize; i++) {
+        if (i % 2 == 1 && package.path.size() > 2) {
+            vector<int> variant = package.path;
+            const int body = static_cast<int>(variant.size()) - 1;
+            for (int swaps = max(1, body / 10); swaps > 0; swaps--) {
+                const int first = rng.below(body);
+                const int second = rng.below(body);
+                swap(variant[first], variant[second]);
+            }
+            starts.push_back(move(variant));
+        } else {
+            vector<int> random = generateRandomPath(settings, rng, static_cast<int>(package.path.size()));
+            pruneCappedSpeedUpgrades(random, context.levels);   // same clean-up as the main start
+            starts.push_back(move(random));
+        }
+    }
+    polishAll(starts);
+    vector<Individual> population;
+    for (OptimizationPackage& member : polished) population.push_back({move(member.path), member.score});
+    survivors(population);
+    double bestScore = population.front().score;
+    context.logger.logImprovement("Memetic", population.front().path, bestScore);
+
+    for (int generation = 1; generation <= settings.memeticGenerations && !cancelled(); generation++) {
+        const int populationCount = static_cast<int>(population.size());
+        auto tournament = [&] {
+            const int x = rng.below(populationCount);
+            const int y = rng.below(populationCount);
+            return population[x].score >= population[y].score ? x : y;
+        };
+        starts.clear();
+        for (int c = 0; c < populationSize; c++) {
+            const int a = tournament();
+            int b = tournament();
+            if (b == a && populationCount > 1) b = (a + 1 + rng.below(populationCount - 1)) % populationCount;
+            const vector<int>& first = population[a].path;
+            const int cut = rng.uniformInt(1, max(1, static_cast<int>(first.size()) - 1));
+            vector<int> child = orderCrossover(first, population[b].path, cut);
+            if (!pathRespectsSpeedCaps(child, context.levels)) child = first;
+            starts.push_back(move(child));
+        }
+        polishAll(starts);
+        for (OptimizationPackage& child : polished) population.push_back({move(child.path), child.score});
+        survivors(population);
+        if (population.front().score > bestScore) {
+            bestScore = population.front().score;
+            context.logger.logImprovement("Memetic", population.front().path, bestScore);
+        }
+        ostringstream summary;
+        summary << "Generation " << generation << "/" << settings.memeticGenerations << ": best " << bestScore
+                << ", worst kept " << population.back().score << "\n";
+        context.logger.logLine(summary.str());
+    }
+    package.path = population.front().path;
+    package.score = population.front().score;
+}
+// =================== LARGE NEIGHBORHOOD SEARCH =========================
+// Re-solves the order and composition of a window of consecutive upgrades
+// exactly. Partial orders are grown one upgrade at a time from the checkpoint at
+// the window start. Of two partial orders using the same upgrades, one whose
+// state is ahead in time and resources in every scenario dominates the other
+// and the other is dropped. Every surviving partial order is also a candidate
+// window (the unused upgrades are dropped), and only those candidates have the
+// rest of the path simulated. Orders whose score bound cannot beat the best
+// window found so far are pruned too. The solve is exact unless a group
+// outgrows LNS_MAX_GROUP_STATES, in which case only its orders with the best
+// bounds are kept.
+constexpr size_t LNS_MAX_GROUP_STATES = 64;
+
+struct WindowNode {
+    vector<SimulationState> states;   // one per scenario
+    UpgradeCounts used{};
+    vector<int> order;
+};
+struct WindowSolution {
+    int start = 0;
+    int length = 0;
+    vector<int> order;
+    double score = -numeric_limits<double>::infinity();
+};
+
+// a's states, run forward to b's clock, hold at least b's resources in every scenario.
+bool windowStateDominates(const vector<SimulationState>& a, const vector<SimulationState>& b) {
+    for (size_t s = 0; s < a.size(); ++s) {
+        if (a[s].targetsMetAt >= 0 || b[s].targetsMetAt >= 0) {
+            if (a[s].targetsMetAt < 0 || (b[s].targetsMetAt >= 0 && b[s].targetsMetAt < a[s].targetsMetAt)) return false;
+            continue;
+        }
+        const double lead = a[s].time - b[s].time;
+        if (lead < 0 || a[s].levels != b[s].levels) return false;
+        for (int i = 0; i < NUM_RESOURCES; i++) {
+            double projected = a[s].resources[i] + a[s].rates[i] * lead;
+            if (i == 9) projected = min(projected, EVENT_CURRENCY_CAP);
+            if (projected < b[s].resources[i]) return false;
+        }
+    }
+    return true;
+}
+WindowSolution solveWindow(const OptimizationPackage& package, const SearchContext& context, int start, int length) {
+    const RunSettings& settings = context.settings;
+    const vector<int>& path = package.path;
+    const int count = scenarioCount(settings);
+    const int suffixStart = start + length;
+    UpgradeCounts windowCounts{};
+    for (int k = start; k < suffixStart; k++) windowCounts[path[k]]++;
+    const UpgradeCounts& suffixCounts = package.suffixCounts[suffixStart];
+
+    WindowSolution best;
+    best.start = start;
+    best.length = length;
+    best.score = package.score;
+    vector<double> values(count);
+    vector<SimulationState> finish;
+    auto tryCompletion = [&](const WindowNode& node) {
+        if (settings.useScoreBound) {
+            for (int s = 0; s < count; s++) values[s] = scoreUpperBound(settings, node.states[s], suffixCounts);
+            if (aggregateScenarios(settings, values) <= best.score) return;
+        }
+        finish = node.states;
+        for (int k = suffixStart; k < static_cast<int>(path.size()); k++) {
+            if (advanceScenarios(settings, finish.data(), count, path[k]) == 0) break;
+        }
+        for (int s = 0; s < count; s++) values[s] = objectiveScore(settings, finish[s]);
+        const double score = aggregateScenarios(settings, values);
+        if (score > best.score) {
+            best.score = score;
+            best.order = node.order;
+        }
+    };
+
+    vector<WindowNode> layer(1);
+    const auto row = package.checkpoints.begin() + static_cast<ptrdiff_t>(start) * count;
+    layer[0].states.assign(row, row + count);
+    for (int depth = 0; depth <= length && !layer.empty(); depth++) {
+        for (const WindowNode& node : layer) tryCompletion(node);
+        if (depth == length) break;
+        // Survivors grouped by the upgrades they used; only orders within a group are comparable.
+        map<UpgradeCounts, vector<WindowNode>> groups;
+        for (const WindowNode& node : layer) {
+            for (int upgradeType = 0; upgradeType <= NUM_RESOURCES * 2; upgradeType++) {
+                if (node.used[upgradeType] >= windowCounts[upgradeType]) continue;
+                WindowNode child = node;
+                child.used[upgradeType]++;
+                child.order.push_back(upgradeType);
+                advanceScenarios(settings, child.states.data(), count, upgradeType);
+                vector<WindowNode>& group = groups[child.used];
+                if (any_of(group.begin(), group.end(), [&](const WindowNode& kept) { return windowStateDominates(kept.states, child.states); })) {
+                    continue;
+                }
+                group.erase(remove_if(group.begin(), group.end(), [&](const WindowNode& kept) { return windowStateDominates(child.states, kept.states); }), group.end());
+                group.push_back(move(child));
+            }
+        }
+        vector<WindowNode> next;
+        for (auto& [used, group] : groups) {
+            UpgradeCounts remaining = suffixCounts;
+            for (int t = 0; t <= NUM_RESOURCES * 2; t++) remaining[t] += windowCounts[t] - used[t];
+            vector<pair<double, size_t>> ranked;
+            for (size_t j = 0; j < group.size(); ++j) {
+                for (int s = 0; s < count; s++) values[s] = scoreUpperBound(settings, group[j].states[s], remaining);
+                const double bound = aggregateScenarios(settings, values);
+                if (!settings.useScoreBound || bound > best.score) ranked.emplace_back(bound, j);
+            }
+            if (ranked.size() > LNS_MAX_GROUP_STATES) {
+                partial_sort(ranked.begin(), ranked.begin() + LNS_MAX_GROUP_STATES, ranked.end(), greater<>());
+                ranked.resize(LNS_MAX_GROUP_STATES);
+            }
+            for (const auto& entry : ranked) next.push_back(move(group[entry.second]));
+        }
+        layer.swap(next);
+    }
+    return best;
+}
+// Solves one sweep of non-overlapping windows in parallel, then applies the
+// improving ones right to left, keeping each only if the whole path improves.
+bool runLnsRound(OptimizationPackage& package, SearchContext& context, ThreadPool& workers, int round) {
+    TraceZone zone("LNS round");
+    const int window = context.settings.lnsWindow;
+    ensureCheckpoints(package, context);
+    if (package.checkpoints.empty()) {
+        return false;
+    }
+    package.score = evaluatePath(package.path, context);
+    const int body = static_cast<int>(package.path.size()) - 1;   // the last entry is the Complete marker
+    vector<int> starts;
+    for (int start = (round % 2) * (window / 2); start + window <= body; start += window) {
+        const auto first = package.path.begin() + start;
+        if (find(first, first + window, NUM_RESOURCES * 2) == first + window) starts.push_back(start);
+    }
+    vector<WindowSolution> solutions(starts.size());
+    TraceZone batch("Solve windows");
+    workers.runBatch(starts.size(), [&](size_t i) {
+        TraceZone task("Solve window");
+        solutions[i] = solveWindow(package, context, starts[i], window);
+    });
+
+    bool improved = false;
+    vector<int> candidate;
+    for (auto it = solutions.rbegin(); it != solutions.rend(); ++it) {
+        if (it->score <= package.score || (context.cancelled && context.cancelled->load())) continue;
+        candidate = package.path;
+        candidate.erase(candidate.begin() + it->start, candidate.begin() + it->start + it->length);
+        candidate.insert(candidate.begin() + it->start, it->order.begin(), it->order.end());
+        const double score = evaluatePath(candidate, context);
+        if (score > package.score) {
+            package.path.swap(candidate);
+            package.score = score;
+            improved = true;
+            context.logger.logImprovement("LNS", package.path, package.score);
+        }
+    }
+    return improved;
+}
+
+// =================== TABU SEARCH =======================================
+// Takes the best admissible sampled move every iteration, improving or not.
+// A taken move's attribute (upgrade type at an index for Insert/Remove, the
+// swapped pair, the rotated span) stays tabu for tabuTenure iterations, which
+// blocks undoing it. A tabu move is still admissible when it beats the best path
+// seen so far (aspiration). Attributes taken often are penalised in proportion
+// to their frequency, which pushes the walk towards moves it has not tried.
+constexpr double TABU_FREQUENCY_PENALTY = 1e-3;   // share of |best score| per unit of relative frequency
+
+using TabuAttribute = array<int, 3>;
+TabuAttribute tabuAttribute(const Proposal& proposal) {
+    if (proposal.type == "Insert" || proposal.type == "Remove") return {0, proposal.indexA, proposal.upgrade};
+    if (proposal.type == "Swap") return {1, proposal.indexA, proposal.indexB};
+    return {2, proposal.indexA, proposal.indexB};
+}
+// Draws one random move on path; Remove proposals carry the removed upgrade type.
+bool sampleTabuMove(const OptimizationPackage& package, const SearchContext& context, CounterRng& rng,
+                    PathEdit& edit, Proposal& proposal) {
+    const vector<int>& path = package.path;
+    const int body = static_cast<int>(path.size()) - 1;   // the Complete marker stays last
+    const int maxTypes = context.settings.allowSpeedUpgrades ? NUM_RESOURCES * 2 : NUM_RESOURCES;
+    if (body < 3) return false;
+    switch (rng() % 4) {
+    case 0: {
+        const int position = rng() % (body + 1);
+        const int upgradeType = rng() % maxTypes;
+        edit = PathEdit::insertAt(position, upgradeType);
+        proposal = Proposal::Insert(position, upgradeType, 0);
+        return true;
+    }
+    case 1: {
+        const int position = rng() % body;
+        if (path[position] >= maxTypes) return false;
+        edit = PathEdit::removeAt(position);
+        proposal = Proposal::Remove(position, 0);
+        proposal.upgrade = path[position];
+        return true;
+    }
+    case 2: {
+        const int i = rng() % body, j = rng() % body;
+        if (path[i] == path[j] || inCommutingRun(package, min(i, j), max(i, j))) return false;
+        edit = PathEdit::swapAt(i, j);
+        proposal = Proposal::Swap(min(i, j), max(i, j), 0);
+        return true;
+    }
+    default: {
+        const int first = rng() % (body - 2);
+        const int last = first + 2 + rng() % (body - first - 1);   // one past the end, at most body
+        if (inCommutingRun(package, first, last - 1)) return false;
+        const int pivot = first + 1 + rng() % (last - first - 1);
+        edit = PathEdit::rotateRange(first, pivot, last);
+        proposal = Proposal::Rotate(first, last, pivot, 0);
+        return true;
+    }
+    }
+}
+void runTabuSearch(OptimizationPackage& package, SearchContext& context) {
+    TraceZone zone("Tabu search");
+    const RunSettings& settings = context.settings;
+    const int candidates = settings.tabuCandidates;
+    ThreadPool workers(searchThreads(context));
+    map<TabuAttribute, long long> tabuUntil;
+    map<TabuAttribute, long long> frequency;
+    vector<PathEdit> edits(candidates);
+    vector<Proposal> proposals(candidates);
+    vector<BoundStats> stats(candidates);
+    package.score = evaluatePath(package.path, context);
+    vector<int> bestPath = package.path;
+    double bestScore = package.score;
+
+    for (long long iteration = 1; iteration <= settings.tabuIterations; iteration++) {
+        if (context.cancelled && context.cancelled->load()) break;
+        ensureCheckpoints(package, context);
+        int drawn = 0;
+        for (int attempt = 0; drawn < candidates && attempt < candidates * 4; attempt++) {
+            if (sampleTabuMove(package, context, package.randomEngine, edits[drawn], proposals[drawn])) drawn++;
+        }
+        TraceZone batch("Tabu batch");
+        workers.runBatch(drawn, [&](size_t i) {
+            stats[i] = BoundStats{};
+            if (package.checkpoints.empty()) {
+                thread_local vector<int> candidate;
+                edits[i].materialize(package.path, candidate);
+                proposals[i].newScore = evaluatePath(candidate, context);
+            } else {
+                proposals[i].newScore = resumeEdit(edits[i], package, context,
+                                                   -numeric_limits<double>::infinity(), stats[i]);
+            }
+        });
+        int chosen = -1;
+        double chosenValue = -numeric_limits<double>::infinity();
+        for (int i = 0; i < drawn; i++) {
+            package.boundStats.candidates += stats[i].candidates;
+            package.boundStats.stepsSimulated += stats[i].stepsSimulated;
+            package.boundStats.stepsReused += stats[i].stepsReused;
+            const double score = proposals[i].newScore;
+            if (score == -numeric_limits<double>::infinity()) continue;
+            const TabuAttribute attribute = tabuAttribute(proposals[i]);
+            const auto tabu = tabuUntil.find(attribute);
+            if (tabu != tabuUntil.end() && tabu->second >= iteration && score <= bestScore) continue;
+            double value = score;
+            if (score <= package.score) {
+                const auto used = frequency.find(attribute);
+                if (used != frequency.end()) {
+                    value -= TABU_FREQUENCY_PENALTY * fabs(bestScore) * used->second / iteration;
+                }
+            }
+            if (value > chosenValue) {
+                chosenValue = value;
+                chosen = i;
+            }
+        }
+        if (chosen < 0) continue;
+        const TabuAttribute attribute = tabuAttribute(proposals[chosen]);
+        tabuUntil[attribute] = iteration + settings.tabuTenure;
+        frequency[attribute]++;
+        edits[chosen].apply(package.path);
+        package.score = proposals[chosen].newScore;
+        if (package.score > bestScore) {
+            bestScore = package.score;
+            bestPath = package.path;
+            context.logger.logImprovement("Tabu", package.path, package.score);
+        }
+    }
+    package.path = move(bestPath);
+    package.score = bestScore;
+}
+
+// =================== SEARCH DRIVER =====================================
+// Local search from the package's path, preceded by the memetic phase, followed
+// by a tabu phase and alternated with large-neighborhood rounds when those are enabled.
+void runSearch(OptimizationPackage& package, SearchContext& context, int maxIterations) {
+    if (context.settings.memeticPopulation > 0) {
+        runMemeticSearch(package, context);
+    }
+    optimizeUpgradePath(package, context, maxIterations);
+    if (context.settings.tabuIterations > 0) {
+        runTabuSearch(package, context);
+        optimizeUpgradePath(package, context, maxIterations);
+    }
+    if (context.settings.lnsWindow > 0) {
+        ThreadPool workers(searchThreads(context));
+        for (int round = 0; round < context.settings.lnsRounds; round++) {
+            if (context.cancelled && context.cancelled->load()) break;
+            if (!runLnsRound(package, context, workers, round)) continue;
+            optimizeUpgradePath(package, context, maxIterations);
+        }
+    }
+}
+
+// =================== SERVER MODE =======================================
+constexpr unsigned short DEFAULT_SERVER_PORT = 8765;
+constexpr int SERVER_PROGRESS_INTERVAL_MS = 250;
+constexpr size_t SERVER_MAX_SESSIONS = 32;
+constexpr int SERVER_KEEPALIVE_MS = 2000;       // also how quickly a closed client is noticed
+
+// Warm state kept between requests that share a session id.
+struct ServerSession {
+    mutex running;                 // one optimization per session at a time
+    vector<int> bestPath;
+    vector<int> bestPathLevels;    // starting levels bestPath was optimized for
+    string busyKey;                // duration + busy windows the cached table belongs to
+    RunSettings settings;
+    chrono::steady_clock::time_point lastUsed = chrono::steady_clock::now();
+};
+class SessionStore {
+    mutex lock;
+    map<string, shared_ptr<ServerSession>> sessions;
+public:
+    shared_ptr<ServerSession> acquire(const string& id) {
+        lock_guard<mutex> guard(lock);
+        auto& slot = sessions[id];
+        if (!slot) {
+            slot = make_shared<ServerSession>();
+        }
+        slot->lastUsed = chrono::steady_clock::now();
+        if (sessions.size() > SERVER_MAX_SESSIONS) {
+            auto oldest = sessions.begin();
+            for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+                if (it->second->lastUsed < oldest->second->lastUsed) oldest = it;
+            }
+            sessions.erase(oldest);
+        }
+        return slot;
+    }
+};
+// Events produced by a worker and drained by the connection thread.
+class EventChannel {
+    mutex lock;
+    condition_variable ready;
+    deque<pair<string, string>> events;
+    bool closed = false;
+public:
+    void push(string event, string data) {
+        {
+            lock_guard<mutex> guard(lock);
+            events.emplace_back(move(event), move(data));
+        }
+        ready.notify_one();
+    }
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+        }
+        ready.notify_one();
+    }
+    enum class Status { Event, Timeout, Closed };
+    Status pop(pair<string, string>& out, chrono::milliseconds timeout) {
+        unique_lock<mutex> guard(lock);
+        if (!ready.wait_for(guard, timeout, [this] { return closed || !events.empty(); })) {
+            return Status::Timeout;
+        }
+        if (events.empty()) {
+            return Status::Closed;
+        }
+        out = move(events.front());
+        events.pop_front();
+        return Status::Event;
+    }
+};
+string busyWindowKey(int totalSeconds, const vector<double>& startHours, const vector<double>& endHours) {
+    ostringstream key;
+    key << setprecision(17) << totalSeconds << "|";
+    printVector(startHours, key);
+    key << "|";
+    printVector(endHours, key);
+    return key.str();
+}
+string formatImprovementJson(const string& type, const vector<int>& path, double score) {
+    ostringstream out;
+    out << setprecision(17) << "{\"type\":\"" << type << "\",\"score\":" << score << ",\"path\":";
+    appendJsonArray(out, path);
+    out << "}";
+    return out.str();
+}
+// Runs one optimization request for a session. File logging, result files and
+// re-planning are ignored here: a request body must never choose paths on disk.
+void runServerJob(const AppConfig& cfg, ServerSession& session, EventChannel& channel, const atomic<bool>& cancelled,
+                  unsigned threads) {
+    lock_guard<mutex> sessionGuard(session.running);
+    const string key = busyWindowKey(makeRunSettings(cfg).totalSeconds, cfg.busyTimesStart, cfg.busyTimesEnd);
+    vector<double> busyTable = move(session.settings.timeNeededSeconds);
+    session.settings = makeRunSettings(cfg);
+    if (key == session.busyKey) {
+        session.settings.timeNeededSeconds = move(busyTable);
+        buildBusySchedules(session.settings, cfg.busyTimesStart, cfg.busyTimesEnd);
+    } else {
+        preprocessBusyTimes(session.settings, cfg.busyTimesStart, cfg.busyTimesEnd);
+        session.busyKey = key;
+    }
+    const RunSettings& settings = session.settings;
+
+    vector<double> startResources = cfg.resourceCounts;
+    clampEventCurrency(startResources);
+    const vector<int>& startLevels = cfg.currentLevels;
+    vector<int> path = cfg.upgradePath;
+    if (!path.empty() && cfg.isFullPath) {
+        adjustFullPath(path, startLevels);
+    }
+    string seed = "config";
+    if (path.empty() && !session.bestPath.empty() && session.bestPathLevels == startLevels) {
+        path = session.bestPath;
+        seed = "session";
+    }
+    if (path.empty()) {
+        CounterRng rng(settings.seed, STREAM_START_PATH);
+        path = generateRandomPath(settings, rng);
+        seed = "random";
+    }
+    pruneCappedSpeedUpgrades(path, startLevels);
+    channel.push("start", string("{\"seed\":\"") + seed + "\"}");
+
+    Logger logger(cfg.outputInterval, false, string(), false);
+    auto lastSent = chrono::steady_clock::now() - chrono::milliseconds(SERVER_PROGRESS_INTERVAL_MS);
+    logger.setImprovementListener([&](const string& type, const vector<int>& improved, double score) {
+        const auto now = chrono::steady_clock::now();
+        if (now - lastSent >= chrono::milliseconds(SERVER_PROGRESS_INTERVAL_MS)) {
+            channel.push("improvement", formatImprovementJson(type, improved, score));
+            lastSent = now;
+        }
+    });
+    if (cfg.runOptimization) {
+        SearchContext context{logger, startResources, startLevels, settings, &cancelled, threads};
+        OptimizationPackage package = {path, 0, CounterRng(settings.seed, STREAM_SEARCH)};
+        runSearch(package, context, cfg.maxOptimizationIterations);
+        path = move(package.path);
+    }
+    pruneCappedSpeedUpgrades(path, startLevels);
+
+    PlanResult result;
+    result.totalSeconds = settings.totalSeconds;
+    result.startLevels = startLevels;
+    result.startResources = startResources;
+    result.upgradePath = path;
+    result.finalLevels = startLevels;
+    result.finalResources = startResources;
+    simulateUpgradePath(settings, path, result.finalLevels, result.finalResources);
+    result.score = nominalScore(settings, path, startLevels, startResources);
+    session.bestPath = path;
+    session.bestPathLevels = startLevels;
+    channel.push(cancelled.load() ? "cancelled" : "result", formatPlanResultJson(result));
+}
+// Fresh secret per server start; only someone who can read the console can use it.
+string makeAccessToken() {
+    random_device device;
+    ostringstream token;
+    token << hex << setfill('0');
+    for (int i = 0; i < 4; i++) token << setw(8) << static_cast<uint32_t>(device());
+    return token.str();
+}
+int runServer(unsigned short port) {
+    nameUpgrades();
+    LocalHttpServer server;
+    if (!server.listen(port)) {
+        return 1;
+    }
+    const string token = makeAccessToken();
+    server.setAccessToken(token);
+    const unsigned cores = max(1u, thread::hardware_concurrency());
+    ThreadPool workers(cores);
+    atomic<unsigned> runningJobs{0};
+    SessionStore sessions;
+    cout << "IdleOptimizer server listening on http://127.0.0.1:" << port
+         << " (" << workers.size() << " workers). Press Ctrl+C to stop.\n"
+         << "Access token: " << token << " (paste it into the GUI's Local Server card)\n" << flush;
+    server.run([&](const HttpRequest& request, HttpConnection& connection) {
+        if (request.method == "GET" && request.path == "/health") {
+            connection.sendResponse(200, "application/json", "{\"status\":\"ok\"}\n");
+            return;
+        }
+        if (request.method != "POST" || request.path != "/optimize") {
+            connection.sendResponse(404, "text/plain", "Use POST /optimize or GET /health\n");
+            return;
+        }
+        nlohmann::json body;
+        try {
+            body = nlohmann::json::parse(request.body);
+        } catch (const exception& e) {
+            connection.sendResponse(400, "text/plain", string("Invalid JSON: ") + e.what() + "\n");
+            return;
+        }
+        string sessionId = request.queryParam("session");
+        if (const nlohmann::json* idNode = body.find("sessionId"); idNode && idNode->is_string()) {
+            sessionId = idNode->get<string>();
+        }
+        if (sessionId.empty()) {
+            sessionId = "default";
+        }
+        auto cfg = make_shared<AppConfig>(configFromJson(body));
+        auto session = sessions.acquire(sessionId);
+        auto channel = make_shared<EventChannel>();
+        auto cancelled = make_shared<atomic<bool>>(false);
+        workers.submit([cfg, session, channel, cancelled, cores, &runningJobs] {
+            // Like batch jobs, a run's parallel phases share the cores with the runs
+            // already going when it starts instead of each taking all of them.
+            const unsigned threads = max(1u, cores / ++runningJobs);
+            try {
+                runServerJob(*cfg, *session, *channel, *cancelled, threads);
+            } catch (const exception& e) {
+                channel->push("error", string("{\"message\":\"") + jsonEscape(e.what()) + "\"}");
+            }
+            runningJobs--;
+            channel->close();
+        });
+        if (!connection.beginEventStream()) {
+            cancelled->store(true);
+            return;
+        }
+        pair<string, string> event;
+        while (true) {
+            const auto status = channel->pop(event, chrono::milliseconds(SERVER_KEEPALIVE_MS));
+            if (status == EventChannel::Status::Closed) {
+                break;
+            }
+            const bool delivered = status == EventChannel::Status::Event
+                ? connection.sendEvent(event.first, event.second)
+                : connection.sendRaw(": keepalive\n\n");
+            if (!delivered) {
+                cancelled->store(true);   // client went away; let the worker wind down
+                return;
+            }
+        }
+    });
+    return 0;
+}
+
+// =================== BATCH MODE ========================================
+// --batch <folder or manifest> [output.jsonl] [budget seconds] optimizes many
+// configs headlessly. Jobs are queued highest priority first on one worker per
+// core; each finished job is written as one JSON line as soon as it is done.
+// A job that exceeds its time budget is cancelled and reports the best path it
+// had reached.
+constexpr int BATCH_WATCHDOG_INTERVAL_MS = 50;
+constexpr const char* DEFAULT_BATCH_OUTPUT = "batch_results.jsonl";
+
+struct BatchJob {
+    string configPath;
+    int priority = 0;
+    double budgetSeconds = 0.0;                 // 0 = no limit
+    atomic<bool> cancelled{false};
+    atomic<long long> deadlineMicros{0};        // steady-clock deadline while running with a budget
+};
+
+long long steadyMicros() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+// A folder queues every *.json in it. A manifest is a JSON array of config
+// paths or of {"config", "priority", "budgetSeconds"} objects; relative paths
+// are resolved against the manifest's folder.
+bool loadBatchJobs(const string& source, double defaultBudget, vector<unique_ptr<BatchJob>>& jobs) {
+    namespace fs = std::filesystem;
+    error_code ec;
+    auto addJob = [&](const string& path, int priority, double budget) {
+        auto job = make_unique<BatchJob>();
+        job->configPath = path;
+        job->priority = priority;
+        job->budgetSeconds = max(0.0, budget);
+        jobs.push_back(move(job));
+    };
+    if (fs::is_directory(source, ec)) {
+        vector<string> paths;
+        for (const auto& entry : fs::directory_iterator(source, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json") paths.push_back(entry.path().string());
+        }
+        sort(paths.begin(), paths.end());
+        for (const string& path : paths) addJob(path, 0, defaultBudget);
+        return true;
+    }
+    ifstream f(source);
+    if (!f.good()) {
+        cerr << "Batch source not found: " << source << "\n";
+        return false;
+    }
+    try {
+        const nlohmann::json manifest = nlohmann::json::parse(f);
+        if (!manifest.is_array()) {
+            cerr << "Batch manifest must be a JSON array: " << source << "\n";
+            return false;
+        }
+        const fs::path base = fs::path(source).parent_path();
+        auto resolve = [&](const string& path) { return fs::path(path).is_absolute() ? path : (base / path).string(); };
+        for (const auto& entry : manifest) {
+            if (entry.is_string()) {
+                addJob(resolve(entry.get<string>()), 0, defaultBudget);
+                continue;
+            }
+            const nlohmann::json* config = entry.find("config");
+            if (!config || !config->is_string()) {
+                cerr << "Skipping manifest entry without a \"config\" path.\n";
+                continue;
+            }
+            const nlohmann::json* priority = entry.find("priority");
+            const nlohmann::json* budget = entry.find("budgetSeconds");
+            addJob(resolve(config->get<string>()),
+                   priority && priority->is_number() ? priority->get<int>() : 0,
+                   budget && budget->is_number() ? budget->get<double>() : defaultBudget);
+        }
+    } catch (const exception& e) {
+        cerr << "Failed to parse batch manifest " << source << ": " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+// Runs one job end to end and returns its JSON line (without the newline).
+string runBatchJob(BatchJob& job, unsigned threads) {
+    const long long started = steadyMicros();
+    ostringstream line;
+    line << setprecision(17) << "{\"config\":\"" << jsonEscape(job.configPath) << "\",\"priority\":" << job.priority;
+    ifstream configFile(job.configPath);
+    if (!configFile.good()) {
+        line << ",\"status\":\"error\",\"error\":\"config not found\"}";
+        return line.str();
+    }
+    // Parsed here rather than through loadConfig, which falls back to defaults on errors.
+    AppConfig cfg;
+    try {
+        cfg = configFromJson(nlohmann::json::parse(configFile));
+    } catch (const exception& e) {
+        line << ",\"status\":\"error\",\"error\":\"" << jsonEscape(string("failed to parse ") + job.configPath + ": " + e.what()) << "\"}";
+        return line.str();
+    }
+    RunSettings settings = makeRunSettings(cfg);
+    preprocessBusyTimes(settings, cfg.busyTimesStart, cfg.busyTimesEnd);
+    vector<double> startResources = cfg.resourceCounts;
+    clampEventCurrency(startResources);
+    const vector<int>& startLevels = cfg.currentLevels;
+    vector<int> path = cfg.upgradePath;
+    if (!path.empty() && cfg.isFullPath) {
+        adjustFullPath(path, startLevels);
+    }
+    if (path.empty()) {
+        CounterRng rng(settings.seed, STREAM_START_PATH);
+        path = generateRandomPath(settings, rng);
+    }
+    pruneCappedSpeedUpgrades(path, startLevels);
+    if (cfg.runOptimization) {
+        if (job.budgetSeconds > 0) {
+            job.deadlineMicros = started + static_cast<long long>(job.budgetSeconds * 1e6);
+        }
+        Logger quiet(1, false, string(), false);
+        SearchContext context{quiet, startResources, startLevels, settings, &job.cancelled, threads};
+        OptimizationPackage package = {path, 0, CounterRng(settings.seed, STREAM_SEARCH)};
+        runSearch(package, context, cfg.maxOptimizationIterations);
+        path = move(package.path);
+        job.deadlineMicros = 0;
+    }
+    pruneCappedSpeedUpgrades(path, startLevels);
+    vector<int> finalLevels = startLevels;
+    vector<double> finalResources = startResources;
+    simulateUpgradePath(settings, path, finalLevels, finalResources);
+    line << ",\"status\":\"" << (job.cancelled.load() ? "timeout" : "ok") << "\""
+         << ",\"milliseconds\":" << (steadyMicros() - started) / 1000
+         << ",\"seed\":" << settings.seed
+         << ",\"score\":" << nominalScore(settings, path, startLevels, startResources)
+         << ",\"upgradePath\":";
+    appendJsonArray(line, path);
+    line << ",\"finalLevels\":";
+    appendJsonArray(line, finalLevels);
+    line << ",\"finalResources\":";
+    appendJsonArray(line, finalResources);
+    line << "}";
+    return line.str();
+}
+int runBatch(const string& source, const string& outputPath, double defaultBudget) {
+    nameUpgrades();
+    vector<unique_ptr<BatchJob>> jobs;
+    if (!loadBatchJobs(source, defaultBudget, jobs)) {
+        return 1;
+    }
+    stable_sort(jobs.begin(), jobs.end(), [](const auto& a, const auto& b) { return a->priority > b->priority; });
+    ofstream file;
+    if (!outputPath.empty() && outputPath != "-") {
+        file.open(outputPath, ios::out | ios::trunc);
+        if (!file.good()) {
+            cerr << "Failed to open batch output: " << outputPath << "\n";
+            return 1;
+        }
+    }
+    ostream& out = file.is_open() ? static_cast<ostream&>(file) : cout;
+    mutex outMutex;
+    atomic<bool> finished{false};
+    thread watchdog([&] {
+        while (!finished.load()) {
+            const long long now = steadyMicros();
+            for (const auto& job : jobs) {
+                const long long deadline = job->deadlineMicros.load();
+                if (deadline > 0 && now >= deadline) job->cancelled = true;
+            }
+            this_thread::sleep_for(chrono::milliseconds(BATCH_WATCHDOG_INTERVAL_MS));
+        }
+    });
+    const long long started = steadyMicros();
+    atomic<long long> busyMicros{0};
+    {
+        const unsigned cores = max(1u, thread::hardware_concurrency());
+        ThreadPool workers(cores);
+        // Each job's parallel phases share the cores with the other running jobs.
+        const unsigned jobThreads = max(1u, cores / static_cast<unsigned>(max<size_t>(1, min<size_t>(jobs.size(), workers.size()))));
+        cerr << "Batch: " << jobs.size() << " jobs on " << workers.size() << " workers.\n";
+        workers.runBatch(jobs.size(), [&](size_t i) {
+            const long long jobStarted = steadyMicros();
+            const string line = runBatchJob(*jobs[i], jobThreads);
+            busyMicros += steadyMicros() - jobStarted;
+            lock_guard<mutex> guard(outMutex);
+            out << line << "\n" << flush;
+        });
+    }
+    finished = true;
+    watchdog.join();
+    cerr << fixed << setprecision(2) << "Batch done: " << jobs.size() << " jobs in "
+         << (steadyMicros() - started) / 1e6 << " s (" << busyMicros.load() / 1e6 << " s of job time).\n";
+    return 0;
+}
+
+// =================== DIFFERENTIAL CHECK ================================
+// Replays random paths from random starting states through both simulators and
+// checks that the score bound taken part-way through never undercuts the final score.
+string checkScoreBound(const RunSettings& settings,
+                       const vector<int>& path,
+                       const vector<int>& levels,
+                       const vector<double>& resources,
+                       int from) {
+    SimulationState state = makeSimulationState(settings, levels, resources);
+    simulatePathFast(settings, vector<int>(path.begin(), path.begin() + from), state);
+    UpgradeCounts remaining{};
+    for (int k = from; k < static_cast<int>(path.size()); k++) remaining[path[k]]++;
+    const double bound = scoreUpperBound(settings, state, remaining);
+    const double finalScore = scorePath(settings, path, levels, resources);
+    if (finalScore <= bound) {
+        return string();
+    }
+    ostringstream diff;
+    diff << setprecision(17) << "bound at step " << from << " is " << bound << " but final score is " << finalScore;
+    return diff.str();
+}
+// Touching windows simulate differently from one merged window (each keeps its
+// own end), so they must not share a result cache entry.
+string checkCacheKeyBusyWindows() {
+    RunSettings split, merged;
+    split.totalSeconds = merged.totalSeconds = 3 * 24 * 3600;
+    preprocessBusyTimes(split, {19.0, 27.0}, {27.0, 35.0});
+    preprocessBusyTimes(merged, {19.0}, {35.0});
+    const vector<int> levels(NUM_RESOURCES * 2 + 1, 1);
+    const vector<double> resources(NUM_RESOURCES, 0.0);
+    const string splitKey = makeCacheKey(split, levels, resources).hashHex();
+    if (splitKey == makeCacheKey(merged, levels, resources).hashHex()) {
+        return "windows [19,27]+[27,35] and [19,35] share cache key " + splitKey;
+    }
+    return string();
+}
+constexpr int DEFAULT_DIFF_CHECK_RUNS = 2000;
+
+int runDifferentialCheck(int runs) {
+    mt19937 rng(20240917u);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    int mismatches = 0;
+    if (const string diff = checkCacheKeyBusyWindows(); !diff.empty()) {
+        cerr << "Cache key: " << diff << "\n";
+        mismatches++;
+    }
+    for (int run = 0; run < runs; ++run) {
+        RunSettings settings;
+        settings.totalSeconds = 3600 * (1 + static_cast<int>(rng() % (24 * 14)));
+        settings.allowSpeedUpgrades = rng() % 4 != 0;
+        const double hours = settings.totalSeconds / 3600.0;
+        vector<double> startHours, endHours;
+        const int windows = static_cast<int>(rng() % 6);
+        for (int w = 0; w < windows; ++w) {
+            const double start = unit(rng) * hours;
+            startHours.push_back(start);
+            endHours.push_back(min(hours, start + unit(rng) * 12.0));
+        }
+        preprocessBusyTimes(settings, startHours, endHours);
+
+        vector<int> levels(NUM_RESOURCES * 2 + 1, 0);
+        for (int i = 0; i < NUM_RESOURCES; i++) {
+            levels[i] = (i == 0 || rng() % 3 != 0) ? 1 + static_cast<int>(rng() % 40) : 0;
+            levels[i + NUM_RESOURCES] = static_cast<int>(rng() % (SPEED_LEVEL_CAP + 1));
+        }
+        vector<double> resources(NUM_RESOURCES, 0.0);
+        for (int i = 0; i < NUM_RESOURCES; i++) {
+            resources[i] = unit(rng) < 0.3 ? 0.0 : pow(10.0, unit(rng) * 8.0);
+        }
+        clampEventCurrency(resources);
+        vector<int> path = generateRandomPath(settings, rng, 20 + static_cast<int>(rng() % 400));
+        for (int& step : path) {
+            if (rng() % 50 == 0) step = NUM_RESOURCES * 2;   // sprinkle in wait-to-end markers
+        }
+
+        string diff = compareSimulators(settings, path, levels, resources);
+        if (diff.empty() && pathRespectsSpeedCaps(path, levels)) {
+            diff = checkScoreBound(settings, path, levels, resources, static_cast<int>(rng() % path.size()));
+        }
+        if (!diff.empty()) {
+            if (++mismatches <= 10) {
+                cerr << "Run " << run << ": " << diff << "\n";
+            }
+        }
+    }
+    cout << "Differential check: " << runs << " runs, " << mismatches << " mismatches.\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
 // =================== MAIN ==============================================
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--serve") {
+        unsigned short port = DEFAULT_SERVER_PORT;
+        if (argc > 2) {
+            try {
+                port = static_cast<unsigned short>(stoi(argv[2]));
+            } catch (...) {
+                cerr << "Invalid port '" << argv[2] << "'; using " << DEFAULT_SERVER_PORT << ".\n";
+            }
+        }
+        return runServer(port);
+    }
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        if (argc < 3) {
+            cerr << "Usage: " << argv[0] << " --batch <folder|manifest> [output.jsonl|-] [budgetSeconds]\n";
+            return 2;
+        }
+        double budget = 0.0;
+        if (argc > 4) {
+            try {
+                budget = max(0.0, stod(argv[4]));
+            } catch (...) {
+                cerr << "Invalid time budget '" << argv[4] << "'; running without one.\n";
+            }
+        }
+        return runBatch(argv[2], argc > 3 ? argv[3] : DEFAULT_BATCH_OUTPUT, budget);
+    }
+    if (argc > 1 && string(argv[1]) == "--diff-check") {
+        int runs = DEFAULT_DIFF_CHECK_RUNS;
+        if (argc > 2) {
+            try {
+                runs = max(1, stoi(argv[2]));
+            } catch (...) {
+                cerr << "Invalid run count '" << argv[2] << "'; using " << DEFAULT_DIFF_CHECK_RUNS << ".\n";
+            }
+        }
+        return runDifferentialCheck(runs);
+    }
+
     // Load config
     AppConfig cfg = loadConfig("config.json");
 
     // Apply config to runtime globals
-    eventDurationDays = max(0, cfg.eventDurationDays);
-    eventDurationHours = max(0, cfg.eventDurationHours);
-    eventDurationMinutes = max(0, cfg.eventDurationMinutes);
-    eventDurationSeconds = max(0, cfg.eventDurationSeconds);
-    long long computedSeconds = static_cast<long long>(eventDurationDays) * 24LL * 3600LL
-        + static_cast<long long>(eventDurationHours) * 3600LL
-        + static_cast<long long>(eventDurationMinutes) * 60LL
-        + static_cast<long long>(eventDurationSeconds);
-    if (computedSeconds <= 0) {
-        computedSeconds = 1;
+    RunSettings settings = makeRunSettings(cfg);
+    if (!cfg.traceFilePath.empty()) {
+        Tracer::instance().enable();
     }
-    totalSeconds = static_cast<int>(min<long long>(computedSeconds, numeric_limits<int>::max()));
-
-    UNLOCKED_PETS = cfg.UNLOCKED_PETS;
-    DLs = cfg.DLs;
     outputInterval = cfg.outputInterval;
-    EVENT_CURRENCY_WEIGHT = cfg.EVENT_CURRENCY_WEIGHT;
-    FREE_EXP_WEIGHT = cfg.FREE_EXP_WEIGHT;
-    PET_STONES_WEIGHT = cfg.PET_STONES_WEIGHT;
-    GROWTH_WEIGHT = cfg.GROWTH_WEIGHT;
     isFullPath = cfg.isFullPath;
-    allowSpeedUpgrades = cfg.allowSpeedUpgrades;
     runOptimization = cfg.runOptimization;
     logToConsoleEnabled = cfg.logToConsole;
     logToFileEnabled = cfg.logToFile;
@@ -793,30 +3019,149 @@ int main() {
     }
     loggerPtr->logLine(mappingStr);
 
+    double planOriginSeconds = 0.0;
+    bool replanning = false;
+    if (!cfg.replanFromResult.empty()) {
+        PlanResult previous;
+        if (loadPlanResult(cfg.replanFromResult, previous)) {
+            replanning = true;
+            planOriginSeconds = cfg.replanElapsedHours * 3600.0;
+            const double remaining = previous.originSeconds + previous.totalSeconds - planOriginSeconds;
+            settings.totalSeconds = static_cast<int>(clamp(remaining, 1.0, static_cast<double>(numeric_limits<int>::max())));
+            shiftBusyWindows(busyTimesStart, busyTimesEnd, cfg.replanElapsedHours);
+            upgradePath = remainingPlanSuffix(previous, currentLevels);
+            maxOptimizationIterations = cfg.replanMaxIterations;
+            ostringstream replanMsg;
+            replanMsg << "Re-planning from " << cfg.replanFromResult << ": "
+                      << cfg.replanElapsedHours << " h elapsed, "
+                      << settings.totalSeconds / 3600.0 << " h remaining, "
+                      << upgradePath.size() - 1 << " upgrades carried over.\n";
+            if (!loggerPtr->isConsoleEnabled()) {
+                cout << replanMsg.str();
+            }
+            loggerPtr->logLine(replanMsg.str());
+        } else {
+            cerr << "Re-plan skipped; running a full optimization instead.\n";
+        }
+    }
+
     nameUpgrades();
-    preprocessBusyTimes(busyTimesStart, busyTimesEnd);
+    preprocessBusyTimes(settings, busyTimesStart, busyTimesEnd);
 
-    if (isFullPath) {
-        adjustFullPath(currentLevels);
+    if (isFullPath && !replanning) {
+        adjustFullPath(upgradePath, currentLevels);
     }
     if (upgradePath.empty()) {
-        upgradePath = generateRandomPath();
+        CounterRng rng(settings.seed, STREAM_START_PATH);
+        upgradePath = generateRandomPath(settings, rng);
     }
     pruneCappedSpeedUpgrades(upgradePath, currentLevels);
 
-    calculateFinalPath(upgradePath, loggerPtr);
+    calculateFinalPath(settings, upgradePath, currentLevels, resourceCounts, loggerPtr);
 
-    if (runOptimization) {
-        random_device seed;
-        mt19937 randomEngine(seed());
-        SearchContext context{*loggerPtr, resourceCounts, currentLevels};
-        OptimizationPackage package = {upgradePath, 0, move(randomEngine)};
-        optimizeUpgradePath(package, context, maxOptimizationIterations);
+    auto announce = [&](const string& message) {
+        if (!loggerPtr->isConsoleEnabled()) {
+            cout << message;
+        }
+        loggerPtr->logLine(message);
+    };
+    unique_ptr<ResultCache> cache;
+    CacheKey cacheKey;
+    bool cacheHit = false;
+    if (runOptimization && !cfg.resultCacheDir.empty()) {
+        cache = make_unique<ResultCache>(cfg.resultCacheDir, cfg.resultCacheMaxEntries);
+        cacheKey = makeCacheKey(settings, currentLevels, resourceCounts);
+        CachedResult cached;
+        double distance = 0.0;
+        if (cache->findExact(cacheKey, cached) && cached.iterations >= maxOptimizationIterations) {
+            upgradePath = cached.upgradePath;
+            cacheHit = true;
+            announce("Result cache hit (" + cacheKey.hashHex() + "); skipping optimization.\n");
+        } else if (cache->findNearest(cacheKey, cfg.resultCacheMaxDistance, cached, distance)) {
+            pruneCappedSpeedUpgrades(cached.upgradePath, currentLevels);
+            if (scorePath(settings, cached.upgradePath, currentLevels, resourceCounts)
+                > scorePath(settings, upgradePath, currentLevels, resourceCounts)) {
+                upgradePath = cached.upgradePath;
+                ostringstream warmMsg;
+                warmMsg << "Warm start from cached result " << cached.key.hashHex()
+                        << " (distance " << distance << ").\n";
+                announce(warmMsg.str());
+            }
+        }
+        pruneCappedSpeedUpgrades(upgradePath, currentLevels);
+    }
+
+    if (runOptimization && !cacheHit) {
+        announce("Seed: " + to_string(settings.seed) + "\n");
+        if (settings.timeToTarget) {
+            ostringstream objectiveMsg;
+            objectiveMsg << "Objective: time until ";
+            for (int i = 0, listed = 0; i < NUM_RESOURCES; i++) {
+                if (settings.targets[i] <= 0) continue;
+                objectiveMsg << (listed++ ? ", " : "") << resourceNames[i] << " >= " << settings.targets[i];
+            }
+            objectiveMsg << " (score = -hours).\n";
+            announce(objectiveMsg.str());
+        }
+        SearchContext context{*loggerPtr, resourceCounts, currentLevels, settings};
+        OptimizationPackage package = {upgradePath, 0, CounterRng(settings.seed, STREAM_SEARCH)};
+        runSearch(package, context, maxOptimizationIterations);
         upgradePath = move(package.path);
+        if (settings.useScoreBound) {
+            announce(formatBoundStats(package.boundStats));
+        }
+        if (settings.screeningTolerance > 0) {
+            announce(formatScreeningStats(package.boundStats));
+        }
+        if (settings.useSymmetryReduction) {
+            announce("Symmetry reduction: " + to_string(package.boundStats.commuting)
+                     + " swaps and rotations skipped inside commuting runs.\n");
+        }
     }
 
     pruneCappedSpeedUpgrades(upgradePath, currentLevels);
-    calculateFinalPath(upgradePath, loggerPtr);
+    calculateFinalPath(settings, upgradePath, currentLevels, resourceCounts, loggerPtr);
+    if (!settings.busyScenarios.empty()) {
+        announce(formatRobustReport(settings, upgradePath, currentLevels, resourceCounts));
+    }
+    if (cfg.upgradeReport) {
+        announce(formatUpgradeReport(settings, upgradePath, currentLevels, resourceCounts));
+    }
+    if (cache && !cacheHit) {
+        CachedResult entry;
+        entry.key = cacheKey;
+        entry.iterations = maxOptimizationIterations;
+        entry.upgradePath = upgradePath;
+        entry.score = scorePath(settings, upgradePath, currentLevels, resourceCounts);
+        cache->store(entry);
+    }
+    if (!cfg.resultFilePath.empty()) {
+        PlanResult result;
+        result.originSeconds = planOriginSeconds;
+        result.totalSeconds = settings.totalSeconds;
+        result.startLevels = currentLevels;
+        result.startResources = resourceCounts;
+        result.upgradePath = upgradePath;
+        result.finalLevels = currentLevels;
+        result.finalResources = resourceCounts;
+        simulateUpgradePath(settings, upgradePath, result.finalLevels, result.finalResources);
+        result.score = nominalScore(settings, upgradePath, currentLevels, resourceCounts);
+        if (writePlanResult(cfg.resultFilePath, result)) {
+            loggerPtr->logLine(string("Result written to ") + cfg.resultFilePath + "\n");
+        }
+    }
+    if (settings.selfCheckInterval > 0) {
+        ostringstream selfCheck;
+        selfCheck << "Simulator self-check: " << selfCheckSamples.load() << " samples, "
+                  << selfCheckMismatches.load() << " mismatches.\n";
+        if (!loggerPtr->isConsoleEnabled()) {
+            cout << selfCheck.str();
+        }
+        loggerPtr->logLine(selfCheck.str());
+    }
+    if (!cfg.traceFilePath.empty() && Tracer::instance().write(cfg.traceFilePath)) {
+        loggerPtr->logLine(string("Trace written to ") + cfg.traceFilePath + "\n");
+    }
     const string doneMessage = string("Done.\n");
     if (loggerPtr) {
         if (!loggerPtr->isConsoleEnabled()) {
@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "result_file.hpp"
+
+// Content-addressed cache of finished optimizations. Entries are keyed by the
+// search-relevant part of a config (duration, weights, starting state, busy
+// windows) after normalisation, so configs that only differ in logging or
+// cosmetics share an entry.
+
+inline constexpr int CACHE_STALE_TEMP_SECONDS = 600;   // older *.tmp files were left by a crashed writer
+
+struct CacheKey {
+    int totalSeconds = 0;
+    bool allowSpeedUpgrades = true;
+    std::array<double, 4> weights{};      // event currency, free exp, pet stones, growth
+    std::vector<int> levels;
+    std::vector<double> resources;
+    std::vector<std::array<int, 3>> busySegments;   // simulator's busy segments: start, end, window end
+    std::vector<double> robust;                     // robust samples, jitter, quantile, seed; empty = nominal
+    std::vector<double> targets;                    // time-to-target goals; empty = weighted score
+
+    std::string canonical() const {
+        std::ostringstream out;
+        out << std::setprecision(17);   // round-trip exact: nearly equal inputs are not an exact hit
+        out << "v3|T=" << totalSeconds << "|S=" << (allowSpeedUpgrades ? 1 : 0) << "|W=";
+        for (double w : weights) out << w << ",";
+        out << "|L=";
+        for (int l : levels) out << l << ",";
+        out << "|R=";
+        for (double r : resources) out << r << ",";
+        out << "|B=";
+        for (const auto& segment : busySegments) out << segment[0] << "-" << segment[1] << ">" << segment[2] << ",";
+        if (!robust.empty()) {
+            out << "|Q=";
+            for (double r : robust) out << r << ",";
+        }
+        if (!targets.empty()) {
+            out << "|G=";
+            for (double t : targets) out << t << ",";
+        }
+        return out.str();
+    }
+    std::string hashHex() const {
+        std::uint64_t hash = 1469598103934665603ULL;   // FNV-1a
+        for (unsigned char c : canonical()) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        std::ostringstream out;
+        out << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return out.str();
+    }
+};
+
+// Both lists sorted and non-overlapping, as the simulator keeps them.
+inline double busyOverlapSeconds(const std::vector<std::array<int, 3>>& a, const std::vector<std::array<int, 3>>& b) {
+    double overlap = 0.0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        const int lo = std::max(a[i][0], b[j][0]);
+        const int hi = std::min(a[i][1], b[j][1]);
+        if (hi >= lo) overlap += hi - lo + 1;
+        if (a[i][1] < b[j][1]) ++i; else ++j;
+    }
+    return overlap;
+}
+
+// Rough "how different is this config" score: hours of busy time that differ,
+// plus level steps, plus log-scale resource differences, plus relative weight
+// changes. Infinite when the entries are not comparable at all.
+inline double cacheKeyDistance(const CacheKey& a, const CacheKey& b) {
+    if (a.totalSeconds != b.totalSeconds || a.allowSpeedUpgrades != b.allowSpeedUpgrades
+        || a.levels.size() != b.levels.size() || a.resources.size() != b.resources.size()
+        || a.robust != b.robust || a.targets != b.targets) {
+        return std::numeric_limits<double>::infinity();
+    }
+    auto busyTotal = [](const std::vector<std::array<int, 3>>& segments) {
+        double total = 0.0;
+        for (const auto& segment : segments) total += segment[1] - segment[0] + 1;
+        return total;
+    };
+    double distance = (busyTotal(a.busySegments) + busyTotal(b.busySegments)
+                       - 2.0 * busyOverlapSeconds(a.busySegments, b.busySegments)) / 3600.0;
+    for (size_t i = 0; i < a.levels.size(); ++i) {
+        distance += std::abs(a.levels[i] - b.levels[i]);
+    }
+    for (size_t i = 0; i < a.resources.size(); ++i) {
+        distance += std::abs(std::log1p(std::max(0.0, a.resources[i])) - std::log1p(std::max(0.0, b.resources[i])));
+    }
+    for (size_t i = 0; i < a.weights.size(); ++i) {
+        const double scale = std::max({std::abs(a.weights[i]), std::abs(b.weights[i]), 1e-300});
+        distance += std::abs(a.weights[i] - b.weights[i]) / scale;
+    }
+    return distance;
+}
+
+struct CachedResult {
+    CacheKey key;
+    int iterations = 0;          // maxOptimizationIterations the entry was produced with
+    std::vector<int> upgradePath;
+    double score = 0.0;
+};
+
+class ResultCache {
+public:
+    ResultCache(std::string directory, int maxEntries)
+        : directory(std::move(directory)), maxEntries(std::max(1, maxEntries)) {}
+
+    bool findExact(const CacheKey& key, CachedResult& out) const {
+        const std::filesystem::path entryPath = entryFor(key);
+        if (!load(entryPath, out) || out.key.canonical() != key.canonical()) {
+            return false;
+        }
+        touch(entryPath);
+        return true;
+    }
+    bool findNearest(const CacheKey& key, double maxDistance, CachedResult& out, double& outDistance) const {
+        outDistance = std::numeric_limits<double>::infinity();
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.path().extension() != ".json") continue;
+            CachedResult candidate;
+            if (!load(entry.path(), candidate)) continue;
+            const double distance = cacheKeyDistance(key, candidate.key);
+            if (distance <= maxDistance && distance < outDistance) {
+                outDistance = distance;
+                out = std::move(candidate);
+            }
+        }
+        return std::isfinite(outDistance);
+    }
+    // Keeps the better of the stored and the new result, written via a temp file and rename.
+    bool store(const CachedResult& result) {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        const std::filesystem::path entryPath = entryFor(result.key);
+        CachedResult merged = result;
+        CachedResult existing;
+        if (load(entryPath, existing) && existing.key.canonical() == result.key.canonical()) {
+            if (existing.score >= result.score && existing.iterations >= result.iterations) {
+                touch(entryPath);
+                return true;
+            }
+            if (existing.score >= result.score) {
+                merged.upgradePath = existing.upgradePath;
+                merged.score = existing.score;
+            }
+            merged.iterations = std::max(existing.iterations, result.iterations);
+        }
+        std::random_device entropy;
+        std::ostringstream tempName;
+        tempName << entryPath.filename().string() << "." << std::hex << entropy() << ".tmp";
+        const std::filesystem::path tempPath = entryPath.parent_path() / tempName.str();
+        {
+            std::ofstream f(tempPath, std::ios::out | std::ios::trunc);
+            if (!f.good()) {
+                std::cerr << "Failed to write result cache entry: " << tempPath.string() << "\n";
+                return false;
+            }
+            f << format(merged);
+            if (!f.good()) {
+                f.close();
+                std::filesystem::remove(tempPath, ec);
+                return false;
+            }
+        }
+        std::filesystem::rename(tempPath, entryPath, ec);
+        if (ec) {
+            std::cerr << "Failed to publish result cache entry: " << ec.message() << "\n";
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        evictOldest();
+        return true;
+    }
+
+private:
+    std::filesystem::path entryFor(const CacheKey& key) const {
+        return std::filesystem::path(directory) / (key.hashHex() + ".json");
+    }
+    static void touch(const std::filesystem::path& path) {
+        std::error_code ec;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    }
+    void evictOldest() const {
+        std::error_code ec;
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+        std::vector<std::filesystem::path> staleTemps;
+        const auto staleBefore = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(CACHE_STALE_TEMP_SECONDS);
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.path().extension() == ".json") {
+                entries.emplace_back(entry.last_write_time(ec), entry.path());
+            } else if (entry.path().extension() == ".tmp" && entry.last_write_time(ec) < staleBefore) {
+                staleTemps.push_back(entry.path());   // a writer still busy with a fresh one is left alone
+            }
+        }
+        for (const auto& path : staleTemps) {
+            std::filesystem::remove(path, ec);
+        }
+        if (static_cast<int>(entries.size()) <= maxEntries) {
+            return;
+        }
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i + maxEntries < entries.size(); ++i) {
+            std::filesystem::remove(entries[i].second, ec);
+        }
+    }
+    static std::string format(const CachedResult& result) {
+        const CacheKey& key = result.key;
+        std::ostringstream out;
+        out << std::setprecision(17);
+        out << "{\n";
+        out << "  \"canonical\": \"" << jsonEscape(key.canonical()) << "\",\n";
+        out << "  \"totalSeconds\": " << key.totalSeconds << ",\n";
+        out << "  \"allowSpeedUpgrades\": " << (key.allowSpeedUpgrades ? "true" : "false") << ",\n";
+        out << "  \"weights\": [" << key.weights[0] << "," << key.weights[1] << ","
+            << key.weights[2] << "," << key.weights[3] << "],\n";
+        out << "  \"levels\": "; appendJsonArray(out, key.levels); out << ",\n";
+        out << "  \"resources\": "; appendJsonArray(out, key.resources); out << ",\n";
+        std::vector<int> busy;
+        for (const auto& segment : key.busySegments) {
+            busy.insert(busy.end(), segment.begin(), segment.end());
+        }
+        out << "  \"busySegments\": "; appendJsonArray(out, busy); out << ",\n";
+        out << "  \"robust\": "; appendJsonArray(out, key.robust); out << ",\n";
+        out << "  \"targets\": "; appendJsonArray(out, key.targets); out << ",\n";
+        out << "  \"iterations\": " << result.iterations << ",\n";
+        out << "  \"upgradePath\": "; appendJsonArray(out, result.upgradePath); out << ",\n";
+        out << "  \"score\": " << result.score << "\n";
+        out << "}\n";
+        return out.str();
+    }
+    static bool load(const std::filesystem::path& path, CachedResult& out) {
+        std::ifstream f(path);
+        if (!f.good()) {
+            return false;
+        }
+        try {
+            const nlohmann::json j = nlohmann::json::parse(f);
+            auto field = [&](const char* name) -> const nlohmann::json& {
+                const nlohmann::json* node = j.find(name);
+                if (!node) throw std::runtime_error(std::string("missing ") + name);
+                return *node;
+            };
+            CacheKey& key = out.key;
+            key.totalSeconds = field("totalSeconds").get<int>();
+            key.allowSpeedUpgrades = field("allowSpeedUpgrades").get<bool>();
+            const auto& weights = field("weights").as_array();
+            for (size_t i = 0; i < key.weights.size() && i < weights.size(); ++i) {
+                key.weights[i] = weights[i].get<double>();
+            }
+            key.levels.clear();
+            for (const auto& v : field("levels")) key.levels.push_back(v.get<int>());
+            key.resources.clear();
+            for (const auto& v : field("resources")) key.resources.push_back(v.get<double>());
+            key.busySegments.clear();
+            const auto& busy = field("busySegments").as_array();
+            for (size_t i = 0; i + 2 < busy.size(); i += 3) {
+                key.busySegments.push_back({busy[i].get<int>(), busy[i + 1].get<int>(), busy[i + 2].get<int>()});
+            }
+            key.robust.clear();
+            if (const nlohmann::json* robust = j.find("robust")) {
+                for (const auto& v : *robust) key.robust.push_back(v.get<double>());
+            }
+            key.targets.clear();
+            if (const nlohmann::json* targets = j.find("targets")) {
+                for (const auto& v : *targets) key.targets.push_back(v.get<double>());
+            }
+            out.iterations = field("iterations").get<int>();
+            out.upgradePath.clear();
+            for (const auto& v : field("upgradePath")) out.upgradePath.push_back(v.get<int>());
+            out.score = field("score").get<double>();
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    std::string directory;
+    int maxEntries;
+};
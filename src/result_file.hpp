@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include "nlohmann/json.hpp"
+#include "json_escape.hpp"
+
+// Snapshot of a finished run, written next to the logs so a later run can pick up from it.
+// originSeconds is the offset of this plan's t=0 from the original launch, so chained
+// re-plans keep measuring elapsed time from the same point as the busy windows.
+struct PlanResult {
+    double originSeconds = 0.0;
+    int totalSeconds = 0;
+    std::vector<int> startLevels;
+    std::vector<double> startResources;
+    std::vector<int> upgradePath;
+    std::vector<int> finalLevels;
+    std::vector<double> finalResources;
+    double score = 0.0;
+};
+
+template <typename T>
+void appendJsonArray(std::ostream& out, const std::vector<T>& values) {
+    out << "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << values[i];
+        if (i + 1 < values.size()) out << ",";
+    }
+    out << "]";
+}
+
+inline std::string formatPlanResultJson(const PlanResult& result) {
+    std::ostringstream out;
+    out << std::setprecision(17);
+    out << "{\n";
+    out << "  \"originSeconds\": " << result.originSeconds << ",\n";
+    out << "  \"totalSeconds\": " << result.totalSeconds << ",\n";
+    out << "  \"startLevels\": "; appendJsonArray(out, result.startLevels); out << ",\n";
+    out << "  \"startResources\": "; appendJsonArray(out, result.startResources); out << ",\n";
+    out << "  \"upgradePath\": "; appendJsonArray(out, result.upgradePath); out << ",\n";
+    out << "  \"finalLevels\": "; appendJsonArray(out, result.finalLevels); out << ",\n";
+    out << "  \"finalResources\": "; appendJsonArray(out, result.finalResources); out << ",\n";
+    out << "  \"score\": " << result.score << "\n";
+    out << "}\n";
+    return out.str();
+}
+
+inline bool writePlanResult(const std::string& path, const PlanResult& result) {
+    try {
+        std::filesystem::path resultPath(path);
+        if (resultPath.has_parent_path()) {
+            std::filesystem::create_directories(resultPath.parent_path());
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Failed to prepare result directory: " << e.what() << "\n";
+    }
+    std::ofstream f(path, std::ios::out | std::ios::trunc);
+    if (!f.good()) {
+        std::cerr << "Failed to open result file: " << path << "\n";
+        return false;
+    }
+    f << formatPlanResultJson(result);
+    return f.good();
+}
+
+inline bool parsePlanResult(const nlohmann::json& j, PlanResult& out) {
+    if (!j.is_object()) {
+        return false;
+    }
+    auto readIntArray = [&](const char* key, std::vector<int>& target) {
+        const nlohmann::json* node = j.find(key);
+        if (!node || !node->is_array()) return false;
+        target.clear();
+        for (const auto& entry : *node) {
+            if (!entry.is_number()) return false;
+            target.push_back(entry.get<int>());
+        }
+        return true;
+    };
+    auto readDoubleArray = [&](const char* key, std::vector<double>& target) {
+        const nlohmann::json* node = j.find(key);
+        if (!node || !node->is_array()) return false;
+        target.clear();
+        for (const auto& entry : *node) {
+            if (!entry.is_number()) return false;
+            target.push_back(entry.get<double>());
+        }
+        return true;
+    };
+    try {
+        const nlohmann::json* origin = j.find("originSeconds");
+        const nlohmann::json* total = j.find("totalSeconds");
+        const nlohmann::json* score = j.find("score");
+        if (!total || !total->is_number()) return false;
+        out.originSeconds = (origin && origin->is_number()) ? origin->get<double>() : 0.0;
+        out.totalSeconds = total->get<int>();
+        out.score = (score && score->is_number()) ? score->get<double>() : 0.0;
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (!readIntArray("upgradePath", out.upgradePath)) return false;
+    if (!readIntArray("startLevels", out.startLevels)) return false;
+    readDoubleArray("startResources", out.startResources);
+    readIntArray("finalLevels", out.finalLevels);
+    readDoubleArray("finalResources", out.finalResources);
+    return true;
+}
+
+inline bool loadPlanResult(const std::string& path, PlanResult& out) {
+    std::ifstream f(path);
+    if (!f.good()) {
+        std::cerr << "Result file not found: " << path << "\n";
+        return false;
+    }
+    try {
+        if (!parsePlanResult(nlohmann::json::parse(f), out)) {
+            std::cerr << "Result file is missing required fields: " << path << "\n";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to parse result file " << path << ": " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads pulling tasks from a shared FIFO queue.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t workerCount) {
+        if (workerCount == 0) {
+            workerCount = 1;
+        }
+        workers.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+    size_t size() const {
+        return workers.size();
+    }
+    // True on a worker of any pool: the caller already runs in a parallel phase.
+    static bool onWorkerThread() {
+        return workerFlag();
+    }
+    // Runs task(0) .. task(count - 1) on the workers and waits for all of them.
+    // Must not be called from one of this pool's own workers.
+    void runBatch(size_t count, const std::function<void(size_t)>& task) {
+        std::mutex doneMutex;
+        std::condition_variable done;
+        size_t remaining = count;
+        for (size_t i = 0; i < count; ++i) {
+            submit([&, i] {
+                task(i);
+                std::lock_guard<std::mutex> guard(doneMutex);
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> guard(doneMutex);
+        done.wait(guard, [&] { return remaining == 0; });
+    }
+
+private:
+    static bool& workerFlag() {
+        thread_local bool flag = false;
+        return flag;
+    }
+    void workerLoop() {
+        workerFlag() = true;
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                available.wait(guard, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+};
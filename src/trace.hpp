@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "json_escape.hpp"
+
+// Opt-in timeline of optimizer phases in Chrome trace format (opens in
+// Perfetto or chrome://tracing). Each thread appends complete ("X") events to
+// its own buffer; buffers stay registered after their thread exits and are
+// written out once at the end. While tracing is off a TraceZone costs one
+// relaxed atomic load.
+
+struct TraceEvent {
+    const char* name;       // must outlive the trace (string literals)
+    long long startMicros;
+    long long durationMicros;
+};
+
+struct TraceBuffer {
+    int threadId = 0;
+    std::vector<TraceEvent> events;
+};
+
+class Tracer {
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+    // Call from the main thread: it is registered first and so becomes tid 0.
+    void enable() {
+        origin = std::chrono::steady_clock::now();
+        threadBuffer();
+        enabled.store(true, std::memory_order_relaxed);
+    }
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    long long nowMicros() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+    void record(const char* name, long long startMicros, long long durationMicros) {
+        threadBuffer().events.push_back(TraceEvent{name, startMicros, durationMicros});
+    }
+    // Call once all traced threads have finished.
+    bool write(const std::string& path) {
+        std::error_code ec;
+        const std::filesystem::path tracePath(path);
+        if (tracePath.has_parent_path()) {
+            std::filesystem::create_directories(tracePath.parent_path(), ec);
+        }
+        std::ofstream f(path, std::ios::out | std::ios::trunc);
+        if (!f.good()) {
+            std::cerr << "Failed to open trace file: " << path << "\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& buffer : buffers) {
+            f << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+              << ",\"args\":{\"name\":\"" << (buffer->threadId == 0 ? "main" : "worker " + std::to_string(buffer->threadId)) << "\"}}";
+            first = false;
+            for (const TraceEvent& event : buffer->events) {
+                f << ",\n{\"name\":\"" << jsonEscape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                  << ",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros << "}";
+            }
+        }
+        f << "\n]}\n";
+        return f.good();
+    }
+
+private:
+    // The calling thread's buffer, registered under the next thread id on first use.
+    TraceBuffer& threadBuffer() {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<TraceBuffer>();
+            std::lock_guard<std::mutex> guard(mutex);
+            buffer->threadId = static_cast<int>(buffers.size());
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+};
+
+// Records the enclosing scope as one event when tracing is on.
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : name(Tracer::instance().isEnabled() ? name : nullptr),
+          startMicros(this->name ? Tracer::instance().nowMicros() : 0) {}
+    ~TraceZone() {
+        if (name) {
+            Tracer& tracer = Tracer::instance();
+            tracer.record(name, startMicros, tracer.nowMicros() - startMicros);
+        }
+    }
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* name;
+    long long startMicros;
+};